@@ -0,0 +1,40 @@
+#include "AllocationCheck.h"
+#ifdef ALLOCATION_CHECK
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+namespace AllocationCheck {
+	std::atomic<long long> allocationCount{ 0 };
+	thread_local bool ignored = false;
+
+	long long GetAllocationCount() {
+		return allocationCount;
+	}
+
+	void IgnoreThisThread() {
+		ignored = true;
+	}
+}
+
+void *operator new(std::size_t size) {
+	if (!AllocationCheck::ignored)
+		AllocationCheck::allocationCount++;
+	void *p = std::malloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+/*
+Optional check that the transient solver does not allocate memory once it is running
+
+When built with ALLOCATION_CHECK defined, global operator new is replaced with a version that counts the
+allocations made by all threads, including the worker threads components are evaluated on. The transient solver
+then reports to stderr any tick after the first that allocated, which would indicate a workspace that is not being
+reused. In batch mode such a tick also makes TransientSolver::RunBatch fail, so that a TRAN run exits with an error.
+Ticks that factorise a block's Jacobian for the first time are excused, as the pattern of its factors is only found then.
+
+Threads that are not part of the simulation, such as the one reading commands in interactive mode, are excluded by
+calling IgnoreThisThread.
+*/
+#ifdef ALLOCATION_CHECK
+namespace AllocationCheck {
+	//Get the number of allocations made by all threads that are not ignored so far
+	long long GetAllocationCount();
+
+	//Stop counting the allocations made by the calling thread
+	void IgnoreThisThread();
+}
+#endif
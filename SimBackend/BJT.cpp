@@ -1,178 +1,122 @@
-#include "DiscreteSemis.h"
-
-
-std::string BJT::GetComponentType() {
-	return "BJT";
-}
-
-int BJT::GetNumberOfPins() {
-	return 3;
-}
-
-void BJT::SetParameters(ParameterSet params) {
-	SaturationCurrent = params.getDouble("is", SaturationCurrent);
-	ForwardGain = params.getDouble("bf", ForwardGain);
-	ReverseGain = params.getDouble("br", ReverseGain);
-	
-	Rcollector = params.getDouble("rc", Rcollector);
-	Rbase = params.getDouble("rb", Rbase);
-	Remitter = params.getDouble("re", Remitter);
-
-	if (strToLower(params.getString("type", "npn")) == "pnp") {
-		MakePNP();
-	}
-}
-
-//Vbe = (Vb - Ib*Rb) - (Ve - Ie * Re)
-//Vbc = (Vb - Ib*Rb) - (Vc - Ic * Rc)
-
-
-double BJT::DCFunction(DCSolver *solver, int f) {
-	double Vbe = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[2]) - Remitter * solver->GetPinCurrent(this, 2));
-	double Vbc = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[0]) - Rcollector * solver->GetPinCurrent(this, 0));
-
-
-	if (f == 0) {
-		double L = SaturationCurrent * ((Math::exp_safe(Vbe / GetVt()) - Math::exp_safe(Vbc / GetVt())) - (1 / ReverseGain) * (Math::exp_safe(Vbc / GetVt()) - 1));
-		double R = solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else if (f == 1) {
-		double L = SaturationCurrent * ((1 / ForwardGain) * (Math::exp_safe(Vbe / GetVt()) - 1) + (1 / ReverseGain) * (Math::exp_safe(Vbc / GetVt()) - 1));
-		double R = solver->GetPinCurrent(this, 1);
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double BJT::TransientFunction(TransientSolver *solver, int f) {
-	double Vbe = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[2]) - Remitter * solver->GetPinCurrent(this, 2));
-	double Vbc = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[0]) - Rcollector * solver->GetPinCurrent(this, 0));
-
-
-	if (f == 0) {
-		double L = SaturationCurrent * ((Math::exp_safe(Vbe / GetVt()) - Math::exp_safe(Vbc / GetVt())) - (1 / ReverseGain) * (Math::exp_safe(Vbc / GetVt()) - 1));
-		double R = solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else if (f == 1) {
-		double L = SaturationCurrent * ((1 / ForwardGain) * (Math::exp_safe(Vbe / GetVt()) - 1) + (1 / ReverseGain) * (Math::exp_safe(Vbc / GetVt()) - 1));
-		double R = solver->GetPinCurrent(this, 1);
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double BJT::DCDerivative(DCSolver *solver, int f, VariableIdentifier var) {
-	double Vbe = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[2]) - Remitter * solver->GetPinCurrent(this, 2));
-	double Vbc = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[0]) - Rcollector * solver->GetPinCurrent(this, 0));
-
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return SaturationCurrent * (-1 / GetVt()) * -1 * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (-1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[1]) {
-				return SaturationCurrent * (1 / GetVt()) * Math::exp_deriv(Vbe / GetVt()) - SaturationCurrent * (1 / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[2]) {
-				return SaturationCurrent * (-1 / GetVt()) * Math::exp_deriv(Vbe / GetVt());
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return SaturationCurrent * (Rcollector / GetVt()) * -1 * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (Rcollector / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - 1;
-			}
-			else if ((var.component == this) && (var.pin == 1)) {
-				return SaturationCurrent * (-Rbase / GetVt()) * Math::exp_deriv(Vbe / GetVt()) - SaturationCurrent * (-Rbase / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (-Rbase / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-		}
-	}
-	else if (f == 1) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return (SaturationCurrent / ReverseGain) * (-1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[1]) {
-				return (SaturationCurrent / ForwardGain) * (1 / GetVt()) * Math::exp_deriv(Vbe / GetVt()) + (SaturationCurrent / ReverseGain) * (1 / GetVt()) * Math::exp_deriv(Vbc / GetVt()) ;
-			}
-			else if (var.net == PinConnections[2]){
-				return (SaturationCurrent / ForwardGain) * (-1 / GetVt()) * Math::exp_deriv(Vbe / GetVt());
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return (SaturationCurrent / ReverseGain) * (Rcollector / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if ((var.component == this) && (var.pin == 1)) {
-				return (SaturationCurrent / ForwardGain) * (-Rbase / GetVt()) * Math::exp_deriv(Vbe / GetVt()) + (SaturationCurrent / ReverseGain) * (-Rbase / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - 1;
-			}
-		}
-	}
-	return 0;
-}
-
-double BJT::TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var) {
-	double Vbe = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[2]) - Remitter * solver->GetPinCurrent(this, 2));
-	double Vbc = (solver->GetNetVoltage(PinConnections[1]) - Rbase * solver->GetPinCurrent(this, 1)) - (solver->GetNetVoltage(PinConnections[0]) - Rcollector * solver->GetPinCurrent(this, 0));
-
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return SaturationCurrent * (-1 / GetVt()) * -1 * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (-1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[1]) {
-				return SaturationCurrent * (1 / GetVt()) * Math::exp_deriv(Vbe / GetVt()) - SaturationCurrent * (1 / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[2]) {
-				return SaturationCurrent * (-1 / GetVt()) * Math::exp_deriv(Vbe / GetVt());
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return SaturationCurrent * (Rcollector / GetVt()) * -1 * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (Rcollector / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - 1;
-			}
-			else if ((var.component == this) && (var.pin == 1)) {
-				return SaturationCurrent * (-Rbase / GetVt()) * Math::exp_deriv(Vbe / GetVt()) - SaturationCurrent * (-Rbase / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - (SaturationCurrent / ReverseGain) * (-Rbase / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-		}
-	}
-	else if (f == 1) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return (SaturationCurrent / ReverseGain) * (-1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[1]) {
-				return (SaturationCurrent / ForwardGain) * (1 / GetVt()) * Math::exp_deriv(Vbe / GetVt()) + (SaturationCurrent / ReverseGain) * (1 / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if (var.net == PinConnections[2]){
-				return (SaturationCurrent / ForwardGain) * (-1 / GetVt()) * Math::exp_deriv(Vbe / GetVt());
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return (SaturationCurrent / ReverseGain) * (Rcollector / GetVt()) * Math::exp_deriv(Vbc / GetVt());
-			}
-			else if ((var.component == this) && (var.pin == 1)) {
-				return (SaturationCurrent / ForwardGain) * (-Rbase / GetVt()) * Math::exp_deriv(Vbe / GetVt()) + (SaturationCurrent / ReverseGain) * (-Rbase / GetVt()) * Math::exp_deriv(Vbc / GetVt()) - 1;
-			}
-		}
-	}
-	return 0;
-}
-
-void BJT::MakePNP() {
-	IsPNP = true;
-	SaturationCurrent = -SaturationCurrent; 
-}
-
-double BJT::GetVt() {
-	if (IsPNP)
-		return -Math::vTherm;
-	else
-		return Math::vTherm;
+#include "DiscreteSemis.h"
+
+
+std::string BJT::GetComponentType() {
+	return "BJT";
+}
+
+int BJT::GetNumberOfPins() {
+	return 3;
+}
+
+bool BJT::SupportsBypass() {
+	return true;
+}
+
+bool BJT::SupportsParallelEvaluation() {
+	return true;
+}
+
+void BJT::SetParameters(ParameterSet params) {
+	SaturationCurrent = params.getDouble("is", SaturationCurrent);
+	ForwardGain = params.getDouble("bf", ForwardGain);
+	ReverseGain = params.getDouble("br", ReverseGain);
+	
+	Rcollector = params.getDouble("rc", Rcollector);
+	Rbase = params.getDouble("rb", Rbase);
+	Remitter = params.getDouble("re", Remitter);
+
+	if (strToLower(params.getString("type", "npn")) == "pnp") {
+		MakePNP();
+	}
+}
+
+//Vbe = (Vb - Ib*Rb) - (Ve - Ie * Re)
+//Vbc = (Vb - Ib*Rb) - (Vc - Ic * Rc)
+
+
+void BJT::MakePNP() {
+	IsPNP = true;
+	SaturationCurrent = -SaturationCurrent; 
+}
+
+double BJT::GetVt() {
+	if (IsPNP)
+		return -Math::vTherm;
+	else
+		return Math::vTherm;
+}
+
+template <typename Solver> void BJT::Stamp(Solver *solver, double *f, double *dfdI, double *dfdV) {
+	double Vt = GetVt();
+	double Ic = solver->GetPinCurrent(this, 0);
+	double Ib = solver->GetPinCurrent(this, 1);
+	double Ie = -(Ic + Ib);
+	double Vb = solver->GetNetVoltage(PinConnections[1]) - Rbase * Ib;
+	double Vbe = Vb - (solver->GetNetVoltage(PinConnections[2]) - Remitter * Ie);
+	double Vbc = Vb - (solver->GetNetVoltage(PinConnections[0]) - Rcollector * Ic);
+	//While limited, the model is linearised about the limited junction voltages (see LimitStep)
+	double VbeLin = StepLimited ? LimitedVbe : Vbe;
+	double VbcLin = StepLimited ? LimitedVbc : Vbc;
+
+	double Ebe, Ebc, dEbe, dEbc;
+	Math::exp_safe_with_deriv(VbeLin / Vt, Ebe, dEbe);
+	Math::exp_safe_with_deriv(VbcLin / Vt, Ebc, dEbc);
+	f[0] = SaturationCurrent * ((Ebe - Ebc) - (1 / ReverseGain) * (Ebc - 1)) - Ic;
+	f[1] = SaturationCurrent * ((1 / ForwardGain) * (Ebe - 1) + (1 / ReverseGain) * (Ebc - 1)) - Ib;
+
+	double Gbe = SaturationCurrent * dEbe / Vt;
+	double Gbc = SaturationCurrent * dEbc / Vt;
+	//Derivatives of each function with respect to Vbe and Vbc
+	double dVbe[2] = { Gbe, Gbe / ForwardGain };
+	double dVbc[2] = { -Gbc * (1 + 1 / ReverseGain), Gbc / ReverseGain };
+	if (StepLimited) {
+		for (int i = 0; i < 2; i++) {
+			f[i] += dVbe[i] * (Vbe - VbeLin) + dVbc[i] * (Vbc - VbcLin);
+		}
+	}
+	if (dfdI == nullptr) return;
+
+	for (int i = 0; i < 2; i++) {
+		//Vbe and Vbc depend on the pin currents through the series resistances (the emitter current being -(Ic + Ib))
+		dfdI[i * 2 + 0] = dVbe[i] * -Remitter + dVbc[i] * Rcollector;
+		dfdI[i * 2 + 1] = dVbe[i] * (-Rbase - Remitter) + dVbc[i] * -Rbase;
+		dfdV[i * 3 + 0] = -dVbc[i];
+		dfdV[i * 3 + 1] = dVbe[i] + dVbc[i];
+		dfdV[i * 3 + 2] = -dVbe[i];
+	}
+	dfdI[0] -= 1;
+	dfdI[3] -= 1;
+}
+
+//Voltages are negated for a PNP transistor while limiting, so that forward bias is positive
+bool BJT::LimitStep(const double *values, const double *step) {
+	double sign = IsPNP ? -1 : 1;
+	double Vcrit = Math::pnjcrit(Math::vTherm, fabs(SaturationCurrent));
+
+	double Ic = values[FirstVariable], Ib = values[FirstVariable + 1];
+	double dIc = step[FirstVariable], dIb = step[FirstVariable + 1];
+	double Vb = GetPinVoltage(values, 1) - Rbase * Ib;
+	double dVb = GetPinVoltageStep(step, 1) - Rbase * dIb;
+	double Vbe = Vb - (GetPinVoltage(values, 2) + Remitter * (Ic + Ib));
+	double dVbe = dVb - (GetPinVoltageStep(step, 2) + Remitter * (dIc + dIb));
+	double Vbc = Vb - (GetPinVoltage(values, 0) - Rcollector * Ic);
+	double dVbc = dVb - (GetPinVoltageStep(step, 0) - Rcollector * dIc);
+
+	//The steps are limited from the voltages the model was last linearised about
+	double VbeOld = StepLimited ? LimitedVbe : Vbe;
+	double VbcOld = StepLimited ? LimitedVbc : Vbc;
+	double VbeNew = Vbe + dVbe, VbcNew = Vbc + dVbc;
+	LimitedVbe = sign * Math::pnjlim(sign * VbeNew, sign * VbeOld, Math::vTherm, Vcrit);
+	LimitedVbc = sign * Math::pnjlim(sign * VbcNew, sign * VbcOld, Math::vTherm, Vcrit);
+	StepLimited = (LimitedVbe != VbeNew) || (LimitedVbc != VbcNew);
+	return StepLimited;
+}
+
+void BJT::TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
+
+void BJT::DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+Micro-benchmark of TransientSolver::GetNetVoltage and GetPinCurrent, the most frequently called functions in the
+backend. This is not part of the project build. It is compiled together with every source file of the backend other
+than SimBackend.cpp and stdafx.cpp, with the backend directory on the include path, and run with a netlist in the
+format the GUI sends before START:
+
+	AccessorBenchmark board.net
+
+Both accessors are called for every pin of every component. They are compared with the lookups they replaced, which
+found the variable of a net or component through a std::map on every call; the maps are rebuilt here from the
+indices the solver assigned, and the values read through GetVarValue.
+*/
+#include "Circuit.h"
+#include "DCSolver.h"
+#include "TransientSolver.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <map>
+#include <chrono>
+#include <cstdio>
+
+static const int Repeats = 2000;
+
+//The variable lookups used before nets and components recorded their own indices
+struct MapLookup {
+	TransientSolver *Solver;
+	std::map<Net*, int> NetVariables;
+	std::map<Component*, int> ComponentVariables;
+
+	double GetNetVoltage(Net *net) {
+		if (net->IsFixedVoltage)
+			return net->NetVoltage;
+		return Solver->GetVarValue(NetVariables[net]);
+	}
+
+	double GetPinCurrent(Component *c, int pin) {
+		if (pin < c->GetNumberOfPins() - 1) {
+			return Solver->GetVarValue(ComponentVariables[c] + pin);
+		}
+		else {
+			double sum = 0;
+			for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
+				sum += GetPinCurrent(c, i);
+			}
+			return -sum;
+		}
+	}
+};
+
+//Call f for every pin of every component, Repeats times, returning the time per call in ns
+template <typename Func> static double TimePins(Circuit &circuit, double &sum, Func f) {
+	long long calls = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < Repeats; r++) {
+		for (auto c = circuit.Components.begin(); c != circuit.Components.end(); ++c) {
+			for (int p = 0; p < (*c)->GetNumberOfPins(); p++) {
+				sum += f(*c, p);
+				calls++;
+			}
+		}
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "usage: AccessorBenchmark <netlist>" << std::endl;
+		return 1;
+	}
+	std::ifstream file(argv[1]);
+	std::stringstream netlist;
+	netlist << file.rdbuf();
+
+	Circuit circuit;
+	circuit.Unattended = true;
+	circuit.ReadNetlist(netlist.str());
+	DCSolver solver(&circuit);
+	solver.Solve();
+	TransientSolver tranSolver(solver);
+
+	MapLookup lookup;
+	lookup.Solver = &tranSolver;
+	for (auto net = circuit.Nets.begin(); net != circuit.Nets.end(); ++net) {
+		if (!(*net)->IsFixedVoltage)
+			lookup.NetVariables[*net] = (*net)->VariableIndex;
+	}
+	for (auto c = circuit.Components.begin(); c != circuit.Components.end(); ++c) {
+		lookup.ComponentVariables[*c] = (*c)->FirstVariable;
+	}
+
+	double sumBefore = 0, sumAfter = 0;
+	double voltageBefore = TimePins(circuit, sumBefore, [&](Component *c, int p) { return lookup.GetNetVoltage(c->PinConnections[p]); });
+	double voltageAfter = TimePins(circuit, sumAfter, [&](Component *c, int p) { return tranSolver.GetNetVoltage(c->PinConnections[p]); });
+	double currentBefore = TimePins(circuit, sumBefore, [&](Component *c, int p) { return lookup.GetPinCurrent(c, p); });
+	double currentAfter = TimePins(circuit, sumAfter, [&](Component *c, int p) { return tranSolver.GetPinCurrent(c, p); });
+
+	printf("%d components, %d nets\n", (int)circuit.Components.size(), (int)circuit.Nets.size());
+	printf("GetNetVoltage  map %.2f ns, indexed %.2f ns\n", voltageBefore, voltageAfter);
+	printf("GetPinCurrent  map %.2f ns, indexed %.2f ns\n", currentBefore, currentAfter);
+	//Both read the same values, so the sums must agree
+	if (sumBefore != sumAfter) {
+		printf("MISMATCH: %.17g vs %.17g\n", sumBefore, sumAfter);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+Accuracy check and micro-benchmark for the exp functions in Math.cpp. This is not part of the project build, and is
+compiled on its own with the same flags as the backend, for example:
+
+	g++ -std=c++14 -O2 -mavx2 -mfma ExpBenchmark.cpp -o ExpBenchmark
+	cl /O2 /EHsc /arch:AVX2 ExpBenchmark.cpp
+
+and again with MATH_FAST_EXP defined to check the shorter polynomial. Math.cpp is included directly, so that the
+polynomial kernels, which are static, can be compared with the library exp.
+
+Over [-limit, limit] the polynomial exp and the vector kernel built (exp4 with AVX2, exp8 with AVX-512) must be within
+the relative error documented in Math.h of the library exp. exp_safe_batch must match exp_safe and exp_deriv to the same
+error, over a range that also covers the linear continuation beyond the limit. Exits with 1 if any check fails.
+*/
+#include "../Math.cpp"
+#include <cstdio>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cfloat>
+
+//See Math.h: with MATH_FAST_EXP the documented bound, otherwise the last bit or two of the library exp
+#ifdef MATH_FAST_EXP
+static const double ExpTolerance = 1e-11;
+#else
+static const double ExpTolerance = 2 * DBL_EPSILON;
+#endif
+
+static const double Limit = 45;
+static const int SweepPoints = 4000001;
+
+static double RelativeError(double value, double reference) {
+	return fabs(value - reference) / fabs(reference);
+}
+
+static bool Check(const char *name, double worst, double worstAt) {
+	bool pass = (worst <= ExpTolerance);
+	printf("%-32s worst relative error %.3g at x=%.9g %s\n", name, worst, worstAt, pass ? "ok" : "FAILED");
+	return pass;
+}
+
+//Evaluate the vector kernel that is built over an array, with the remainder through exp_poly
+static void VectorExp(const double *x, double *y, int n) {
+	int k = 0;
+#if defined(__AVX512F__)
+	for (; k + 8 <= n; k += 8) {
+		_mm512_storeu_pd(y + k, Math::exp8(_mm512_loadu_pd(x + k)));
+	}
+#elif defined(__AVX2__)
+	for (; k + 4 <= n; k += 4) {
+		_mm256_storeu_pd(y + k, Math::exp4(_mm256_loadu_pd(x + k)));
+	}
+#endif
+	for (; k < n; k++) {
+		y[k] = Math::exp_poly(x[k]);
+	}
+}
+
+static bool CheckAccuracy() {
+	bool pass = true;
+	std::vector<double> x(SweepPoints), y(SweepPoints);
+	for (int i = 0; i < SweepPoints; i++) {
+		x[i] = -Limit + (2 * Limit * i) / (SweepPoints - 1);
+	}
+
+	double worst = 0, worstAt = 0;
+	for (int i = 0; i < SweepPoints; i++) {
+		double err = RelativeError(Math::exp_poly(x[i]), exp(x[i]));
+		if (err > worst) {
+			worst = err;
+			worstAt = x[i];
+		}
+	}
+	pass &= Check("exp_poly", worst, worstAt);
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+	VectorExp(x.data(), y.data(), SweepPoints);
+	worst = 0;
+	for (int i = 0; i < SweepPoints; i++) {
+		double err = RelativeError(y[i], exp(x[i]));
+		if (err > worst) {
+			worst = err;
+			worstAt = x[i];
+		}
+	}
+#if defined(__AVX512F__)
+	pass &= Check("exp8", worst, worstAt);
+#else
+	pass &= Check("exp4", worst, worstAt);
+#endif
+#else
+	printf("exp4/exp8 not built, compile with AVX2 or AVX-512 to check them\n");
+#endif
+
+	//Twice the limit, so that the clamped linear part is covered too. An odd count leaves a scalar tail.
+	std::vector<double> e(SweepPoints), de(SweepPoints);
+	for (int i = 0; i < SweepPoints; i++) {
+		x[i] = -2 * Limit + (4 * Limit * i) / (SweepPoints - 1);
+	}
+	Math::exp_safe_batch(x.data(), e.data(), de.data(), SweepPoints, Limit);
+	double worstDeriv = 0, worstDerivAt = 0;
+	worst = 0;
+	for (int i = 0; i < SweepPoints; i++) {
+		double err = RelativeError(e[i], Math::exp_safe(x[i], Limit));
+		if (err > worst) {
+			worst = err;
+			worstAt = x[i];
+		}
+		err = RelativeError(de[i], Math::exp_deriv(x[i], Limit));
+		if (err > worstDeriv) {
+			worstDeriv = err;
+			worstDerivAt = x[i];
+		}
+	}
+	pass &= Check("exp_safe_batch vs exp_safe", worst, worstAt);
+	pass &= Check("exp_safe_batch vs exp_deriv", worstDeriv, worstDerivAt);
+	return pass;
+}
+
+template <typename Func> static void Time(const char *name, int n, Func f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	printf("%-32s %.2f ns per value\n", name, ns / n);
+}
+
+static void Benchmark() {
+	const int n = 1000000;
+	std::vector<double> x(n), e(n), de(n);
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> dist(-1.5 * Limit, 1.5 * Limit);
+	for (int i = 0; i < n; i++) {
+		x[i] = dist(rng);
+	}
+
+	Time("exp_safe + exp_deriv", n, [&]() {
+		for (int i = 0; i < n; i++) {
+			e[i] = Math::exp_safe(x[i], Limit);
+			de[i] = Math::exp_deriv(x[i], Limit);
+		}
+	});
+	Time("exp_safe_with_deriv", n, [&]() {
+		for (int i = 0; i < n; i++) {
+			Math::exp_safe_with_deriv(x[i], e[i], de[i], Limit);
+		}
+	});
+	Time("exp_safe_batch", n, [&]() {
+		Math::exp_safe_batch(x.data(), e.data(), de.data(), n, Limit);
+	});
+	//Keep the results live
+	double sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += e[i] + de[i];
+	}
+	printf("(checksum %g)\n", sum);
+}
+
+int main() {
+#ifdef MATH_FAST_EXP
+	printf("MATH_FAST_EXP: polynomial of degree %d, tolerance %g\n", Math::expDegree, ExpTolerance);
+#else
+	printf("Library exp, polynomial of degree %d, tolerance %g\n", Math::expDegree, ExpTolerance);
+#endif
+	bool pass = CheckAccuracy();
+	Benchmark();
+	return pass ? 0 : 1;
+}
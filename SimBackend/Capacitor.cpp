@@ -1,102 +1,97 @@
-#include "PassiveComponents.h"
-
-std::string Capacitor::GetComponentType() {
-	return "C";
-}
-
-int Capacitor::GetNumberOfPins() {
-	return 2;
-}
-
-void Capacitor::SetParameters(ParameterSet params) {
-	Capacitance = params.getDouble("cap", Capacitance);
-	SeriesResistance = params.getDouble("rser", SeriesResistance);
-}
-
-double Capacitor::DCFunction(DCSolver *solver, int f) {
-	if (f == 0) {
-		double L = (solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1])) / DCResistance;
-		double R = solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double Capacitor::TransientFunction(TransientSolver *solver, int f) {
-	if (f == 0) {
-
-		double I0 = solver->GetPinCurrent(this, 0, solver->GetCurrentTick() - 1);
-		double I = solver->GetPinCurrent(this, 0);
-		double V0 = solver->GetNetVoltage(PinConnections[0], solver->GetCurrentTick() - 1) - solver->GetNetVoltage(PinConnections[1], solver->GetCurrentTick() - 1) - SeriesResistance * I0;
-		double V = solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * I;
-		double DT = solver->GetTimeAtTick(solver->GetCurrentTick()) - solver->GetTimeAtTick(solver->GetCurrentTick() - 1);
-
-		double L = V;
-		double R;
-		if (solver->GetTimeAtTick(solver->GetCurrentTick()) != lastT) {
-			lastT = solver->GetTimeAtTick(solver->GetCurrentTick());
-			usingBE = false;
-		}
-		if ((fabs(V - V0) > 0.5) || usingBE) {
-			usingBE = true;
-		}
-		else {
-			R = V0 + DT * (I0 + I) / (2 * Capacitance);
-		}
-		R = V0 + (DT / Capacitance) * I;
-
-		solver->RequestTimestep(fmax(abs((0.05*Capacitance) / ((I + I0) * DT)), 1e-10));
-
-		return L - R;
-
-
-	}
-	else {
-		return 0;
-	}
-}
-
-double Capacitor::DCDerivative(DCSolver *solver, int f, VariableIdentifier var) {
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) return 1  / DCResistance;
-			if (var.net == PinConnections[1]) return -1 / DCResistance;
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) return -1;
-		}
-	}
-	return 0;
-}
-
-double Capacitor::TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var) {
-	if (f == 0) {
-		double V0 = solver->GetNetVoltage(PinConnections[0], solver->GetCurrentTick() - 1) - solver->GetNetVoltage(PinConnections[1], solver->GetCurrentTick() - 1);
-		double V = solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]);
-		double I0 = solver->GetPinCurrent(this, 0, solver->GetCurrentTick() - 1);
-		double I = solver->GetPinCurrent(this, 0);
-		double DT = solver->GetTimeAtTick(solver->GetCurrentTick()) - solver->GetTimeAtTick(solver->GetCurrentTick() - 1);
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return 1;
-			}
-			else if (var.net == PinConnections[1]) {
-				return -1;
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				if (usingBE) {
-					return -SeriesResistance - DT / Capacitance;
-				}
-				else {
-					return -SeriesResistance - DT / (2 * Capacitance);
-				}
-				
-			}
-		}
-	}
-	return 0;
-}
+#include "PassiveComponents.h"
+
+std::string Capacitor::GetComponentType() {
+	return "C";
+}
+
+int Capacitor::GetNumberOfPins() {
+	return 2;
+}
+
+//The derivatives only depend on the timestep and integration method through GetDerivativeWeight(0), which the solver tracks
+Component::JacobianDependence Capacitor::GetJacobianDependence() {
+	return JACOBIAN_PER_TICK;
+}
+
+bool Capacitor::IsLinear() {
+	return true;
+}
+
+bool Capacitor::SupportsParallelEvaluation() {
+	return true;
+}
+
+void Capacitor::SetParameters(ParameterSet params) {
+	Capacitance = params.getDouble("cap", Capacitance);
+	SeriesResistance = params.getDouble("rser", SeriesResistance);
+}
+
+template <typename Solver> void Capacitor::Stamp(Solver *solver, double *f, double *dfdI, double *dfdV) {
+	//With the infinite timestep of the DC solver, the capacitor is an open circuit apart from a small leakage
+	double DT = solver->GetTimestep();
+	if (std::isinf(DT)) {
+		f[0] = (solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1])) / DCResistance - solver->GetPinCurrent(this, 0);
+		if (dfdI == nullptr) return;
+		dfdI[0] = -1;
+		dfdV[0] = 1 / DCResistance;
+		dfdV[1] = -1 / DCResistance;
+		return;
+	}
+
+	//The voltage is found by the integration method from the current, and the voltages and current at earlier ticks
+	int tick = solver->GetCurrentTick();
+	double I = solver->GetPinCurrent(this, 0);
+	double V = GetVoltage(solver, tick);
+	double Vint = solver->GetDerivativeWeight(0) * I / Capacitance;
+	for (int k = 1; k <= solver->GetIntegrationOrder(); k++) {
+		Vint += solver->GetIntegrationCoefficient(k) * GetVoltage(solver, tick - k);
+	}
+	if (solver->GetDerivativeWeight(1) != 0) {
+		Vint += solver->GetDerivativeWeight(1) * solver->GetPinCurrent(this, 0, tick - 1) / Capacitance;
+	}
+	f[0] = V - Vint;
+
+	if (dfdI == nullptr) return;
+	dfdI[0] = -SeriesResistance - solver->GetDerivativeWeight(0) / Capacitance;
+	dfdV[0] = 1;
+	dfdV[1] = -1;
+}
+
+template <typename Solver> double Capacitor::GetVoltage(Solver *solver, int tick) {
+	return solver->GetNetVoltage(PinConnections[0], tick) - solver->GetNetVoltage(PinConnections[1], tick) - SeriesResistance * solver->GetPinCurrent(this, 0, tick);
+}
+
+/*
+The error is estimated by the solver from the voltages at the last few ticks. The trapezoidal rule rings as a current
+whose change alternates in sign from tick to tick, so this is also checked for over the last four ticks.
+*/
+double Capacitor::GetTruncationError(TransientSolver *solver) {
+	int tick = solver->GetCurrentTick();
+	if (tick >= 3) {
+		double I[4];
+		for (int k = 0; k < 4; k++) {
+			I[k] = solver->GetPinCurrent(this, 0, tick - k);
+		}
+		if (((I[0] - I[1]) * (I[1] - I[2]) < 0) && ((I[1] - I[2]) * (I[2] - I[3]) < 0)
+			&& ((solver->GetTimestep() * fabs(I[0] - I[1]) / Capacitance) > solver->TruncationVoltageTolerance))
+			solver->ReportRinging();
+	}
+
+	int points = solver->GetTruncationErrorPoints();
+	if (points == 0) return 0;
+	double V[TransientSolver::MaximumIntegrationOrder + 2];
+	double Vmax = 0;
+	for (int k = 0; k < points; k++) {
+		V[k] = GetVoltage(solver, tick - k);
+		if (k < 2) Vmax = fmax(Vmax, fabs(V[k]));
+	}
+	return solver->EstimateTruncationError(V) / (solver->TruncationRelativeTolerance * Vmax + solver->TruncationVoltageTolerance);
+}
+
+void Capacitor::TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
+
+void Capacitor::DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
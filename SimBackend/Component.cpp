@@ -1,13 +1,81 @@
-#include "Component.h"
-
-VariableIdentifier Component::getComponentVariableIdentifier(int pin) {
-	VariableIdentifier id;
-	id.type = VariableIdentifier::VariableType::COMPONENT;
-	id.component = this;
-	id.pin = pin;
-	return id;
-}
-
-void Component::SetParameters(ParameterSet params) {
-
-}
\ No newline at end of file
+#include "Component.h"
+#include <algorithm>
+
+VariableIdentifier Component::getComponentVariableIdentifier(int pin) {
+	VariableIdentifier id;
+	id.type = VariableIdentifier::VariableType::COMPONENT;
+	id.component = this;
+	id.pin = pin;
+	return id;
+}
+
+void Component::SetParameters(ParameterSet params) {
+
+}
+
+Component::JacobianDependence Component::GetJacobianDependence() {
+	return JACOBIAN_NONLINEAR;
+}
+
+bool Component::SupportsBypass() {
+	return false;
+}
+
+bool Component::IsLinear() {
+	return false;
+}
+
+bool Component::SupportsParallelEvaluation() {
+	return false;
+}
+
+bool Component::LimitStep(const double *values, const double *step) {
+	return false;
+}
+
+bool Component::IsStepLimited() {
+	return StepLimited;
+}
+
+void Component::ResetStepLimit() {
+	StepLimited = false;
+}
+
+double Component::GetTruncationError(TransientSolver *solver) {
+	return 0;
+}
+
+void Component::RejectTick() {
+
+}
+
+void Component::CheckEvents(TransientSolver *solver) {
+
+}
+
+void Component::SetNetDerivatives(double *dfdV, int i, const int *pins, const double *derivatives, int count) {
+	int npin = PinConnections.size();
+	std::fill(dfdV + i * npin, dfdV + (i + 1) * npin, 0.0);
+	for (int k = 0; k < count; k++) {
+		Net *net = PinConnections[pins[k]];
+		if (net->IsFixedVoltage) continue;
+		//The derivatives for a net are summed against the first pin connected to it
+		int first = 0;
+		while (PinConnections[first] != net) first++;
+		dfdV[i * npin + first] += derivatives[k];
+	}
+}
+
+double Component::GetPinVoltage(const double *values, int pin) {
+	if (PinVariables[pin] < 0)
+		return PinConnections[pin]->NetVoltage;
+	else
+		return values[PinVariables[pin]];
+}
+
+double Component::GetPinVoltageStep(const double *step, int pin) {
+	if (PinVariables[pin] < 0)
+		return 0;
+	else
+		return step[PinVariables[pin]];
+}
@@ -1,64 +1,154 @@
-#pragma once
-
-#include <string>
-#include <map>
-class ParameterSet;
-struct VariableIdentifier;
-#include "Net.h"
-#include "ParameterSet.h"
-#include "DCSolver.h"
-#include "TransientSolver.h"
-/*
-This class provides a minimum generic interface that all components derive from
-As components may have more than two pins, there is the cabilitity for components to have multiple current variables, and thus multiple equations to solve.
-For a generic component with n pins, there will be n-1 current variables and n-1 equations.
-The current flowing in the remaining pin is equal to negative the sum of the currents through all other pins.
-
-Pin numbers and function nunbers both start from 0.
-*/
-class Component
-{
-public:
-	//Number of pins that the component has
-	virtual int GetNumberOfPins() = 0;
-	
-	//Return a type string identifying the component (e.g. R for resistor, AC for AC source)
-	virtual std::string GetComponentType() = 0;
-
-	//Reference designator, e.g. R1 or D3
-	std::string ComponentID; 
-
-	//List of nets the component is connected to, identified by pin number
-	std::vector<Net*> PinConnections;
-
-	/*
-	Returns a function that can be used by the non-linear DC operating point solver
-	to solve as f(x) = 0
-	For components with greater than 2 pins, f is the indentifier of the function 0 <= f < n-1
-	*/
-	virtual double DCFunction(DCSolver *solver, int f) = 0;
-
-	/*
-	Returns a function that can be used by the non-linear transient solver
-	to solve as f(x) = 0
-	For components with greater than 2 pins, f is the indentifier of the function 0 <= f < n-1
-	*/
-	virtual double TransientFunction(TransientSolver *solver, int f) = 0;
-
-	/*
-	Evaluate the partial derivatives for the above functions
-	*/
-	virtual double DCDerivative(DCSolver *solver, int f, VariableIdentifier var) = 0;
-	virtual double TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var) = 0;
-
-	/*
-	Get the identifier for the current variable for a pin
-	*/
-	VariableIdentifier getComponentVariableIdentifier(int pin);
-
-	/*
-	Initialise component parameters from a parameter set
-	*/
-	virtual void SetParameters(ParameterSet params);
-};
-
+#pragma once
+
+#include <string>
+#include <map>
+class ParameterSet;
+struct VariableIdentifier;
+#include "Net.h"
+#include "ParameterSet.h"
+#include "DCSolver.h"
+#include "TransientSolver.h"
+/*
+This class provides a minimum generic interface that all components derive from
+As components may have more than two pins, there is the cabilitity for components to have multiple current variables, and thus multiple equations to solve.
+For a generic component with n pins, there will be n-1 current variables and n-1 equations.
+The current flowing in the remaining pin is equal to negative the sum of the currents through all other pins.
+
+Pin numbers and function nunbers both start from 0.
+*/
+class Component
+{
+public:
+	//Number of pins that the component has
+	virtual int GetNumberOfPins() = 0;
+	
+	//Return a type string identifying the component (e.g. R for resistor, AC for AC source)
+	virtual std::string GetComponentType() = 0;
+
+	//Reference designator, e.g. R1 or D3
+	std::string ComponentID; 
+
+	//List of nets the component is connected to, identified by pin number
+	std::vector<Net*> PinConnections;
+
+	/*
+	Variables given to the component when it is added to a solver. The current into pin p (p < n-1) is variable
+	FirstVariable + p, and PinVariables[p] is the voltage variable of the net on pin p (-1 if fixed voltage)
+	*/
+	int FirstVariable = -1;
+	std::vector<int> PinVariables;
+
+	/*
+	Evaluate the n-1 functions of the component, to be solved as f(x) = 0, and optionally their derivatives, in a single
+	call so that work such as finding pin voltages or exponentials is shared between them.
+
+	f[i] is set to the value of function i
+	If dfdI is not null, dfdI[i*(n-1) + p] is set to the derivative of function i with respect to the current into pin p
+	(for p < n-1) and dfdV[i*n + p] to the derivative with respect to the voltage of the net on pin p. Both arrays are
+	zeroed by the caller, so only non-zero entries need to be set. If two pins share a net the derivatives are summed.
+
+	The transient solver calls TransientStamp and the DC operating point solver DCStamp. Components implement both with
+	one function templated on the solver, as the DC solver provides the same methods for components to use, with the
+	operating point treated as a tick with an infinite timestep (see DCSolver::GetTimestep).
+	*/
+	virtual void TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV) = 0;
+	virtual void DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV) = 0;
+
+	/*
+	What the transient derivatives depend on, so the solver knows how often they need to be stamped again.
+	JACOBIAN_CONSTANT: only the component parameters
+	JACOBIAN_PER_TICK: the timestep, or other state fixed during a tick. The solver stamps them again whenever the
+	derivative weight of the integration method (TransientSolver::GetDerivativeWeight(0)) changes, which covers the
+	timestep and the integration method. Whenever any other state they depend on changes, the component must call
+	TransientSolver::InvalidateTickStamps
+	JACOBIAN_NONLINEAR: the variable values, so they are stamped at every iteration (the default)
+	*/
+	enum JacobianDependence {
+		JACOBIAN_CONSTANT,
+		JACOBIAN_PER_TICK,
+		JACOBIAN_NONLINEAR
+	};
+	virtual JacobianDependence GetJacobianDependence();
+
+	/*
+	Whether the transient solver may skip evaluating the component while its pin voltages and currents have hardly
+	changed, predicting the functions from the derivatives found at its last evaluation instead. This is only valid
+	if TransientStamp depends on nothing but the present variable values, and has no side effects.
+	*/
+	virtual bool SupportsBypass();
+
+	//Whether the transient functions are linear in the variables for a given timestep
+	virtual bool IsLinear();
+
+	/*
+	Whether TransientStamp may be called on a worker thread, at the same time as other components are evaluated. This
+	is only valid if it changes no state outside the component, other than through RequestTimestep and
+	InvalidateTickStamps.
+	*/
+	virtual bool SupportsParallelEvaluation();
+
+	/*
+	Junction voltage limiting, called by the solvers for each Newton-Raphson step between finding the step and taking it.
+	values holds the variables before the step and step the change found for each, both indexed by variable.
+
+	Where the step would carry a junction far into forward bias, beyond which the linearised model overshoots badly (or a
+	MOSFET far across its threshold), the component records a limited voltage for the junction and sets StepLimited, as
+	pnjlim and fetlim do in SPICE. Until the next step its functions are then those of the model linearised about the
+	limited voltage, so the junction only moves part of the way while every other variable takes the full step. Returns
+	StepLimited, which the solvers check so as not to accept a solution found with a limited model.
+	*/
+	virtual bool LimitStep(const double *values, const double *step);
+
+	//Whether the component is evaluated at limited junction voltages, see LimitStep
+	bool IsStepLimited();
+
+	//Return to evaluating the component at the variable values, without limiting
+	void ResetStepLimit();
+
+	/*
+	Estimate the local truncation error of the tick just solved, for components whose functions integrate over the
+	timestep such as capacitors. This is returned as a fraction of the tolerance set by the solver (see
+	TransientSolver::TruncationRelativeTolerance), so a value above 1 means the timestep was too long. Components
+	without such state return 0.
+	*/
+	virtual double GetTruncationError(TransientSolver *solver);
+
+	/*
+	Called when the transient solver rejects the tick just solved, so it can be taken again with a shorter timestep.
+	Components that update state of their own during a tick, such as sequential logic, return it to how it was at the
+	start of the tick.
+	*/
+	virtual void RejectTick();
+
+	/*
+	Called once a tick has been solved, for components that respond to discrete events such as a logic input crossing
+	its threshold. A component that finds an event part way through the tick calls TransientSolver::RequestBreakpoint,
+	so that the tick is taken again ending at the event.
+	*/
+	virtual void CheckEvents(TransientSolver *solver);
+
+	/*
+	Get the identifier for the current variable for a pin
+	*/
+	VariableIdentifier getComponentVariableIdentifier(int pin);
+
+	/*
+	Initialise component parameters from a parameter set
+	*/
+	virtual void SetParameters(ParameterSet params);
+
+protected:
+	/*
+	Set the derivatives of function i with respect to the nets, given the derivative with respect to the net on each of
+	a list of pins. Where several listed pins share a net, the derivatives given for them are summed, as the function
+	depends on the net through each of them. Nothing is set for fixed voltage nets.
+	*/
+	void SetNetDerivatives(double *dfdV, int i, const int *pins, const double *derivatives, int count);
+
+	//Get the voltage of the net on a pin, and its change in a step, from values and step as passed to LimitStep
+	double GetPinVoltage(const double *values, int pin);
+	double GetPinVoltageStep(const double *step, int pin);
+
+	bool StepLimited = false;
+};
+
@@ -1,157 +1,463 @@
-#include "DCSolver.h"
-
-bool VariableIdentifier::operator==(VariableIdentifier& other)const {
-	if (type == other.type) {
-		if (type == VariableType::COMPONENT) {
-			return ((component == other.component) && (pin == other.pin));
-		}
-		else {
-			return (net == other.net);
-		}
-	}
-	return false;
-}
-
-DCSolver::DCSolver(Circuit *circuit) {
-	SolverCircuit = circuit;
-	for (auto n = circuit->Nets.begin(); n != circuit->Nets.end(); ++n) {
-		AddNet(*n);
-	}
-	for (auto c = circuit->Components.begin(); c != circuit->Components.end(); ++c) {
-		AddComponent(*c);
-	}
-}
-
-void DCSolver::AddComponent(Component *c) {
-	//Due to Kirchoff's Laws, for a component with n pins we only need n-1 equations
-
-	ComponentVariables[c] = nextFreeVariable;
-	nextFreeVariable += c->GetNumberOfPins() - 1;
-
-	for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
-		VariableValues.push_back(0.1);
-		VariableIdentifier id;
-		id.type = VariableIdentifier::VariableType::COMPONENT;
-		id.component = c;
-		id.pin = i;
-		VariableData[ComponentVariables[c] + i] = id;
-	}
-}
-
-void DCSolver::AddNet(Net *net) {
-	if (!net->IsFixedVoltage) {
-		NetVariables[net] = nextFreeVariable;
-		VariableValues.push_back(0.1);
-		VariableIdentifier id;
-		id.type = VariableIdentifier::VariableType::NET;
-		id.net = net;
-		VariableData[nextFreeVariable] = id;
-		nextFreeVariable++;
-	}
-}
-
-bool DCSolver::Solve(double tol, int maxIter, bool attemptRamp) {
-	int n = VariableValues.size();
-	double worstTol = 0;
-	//The matrix to solve by Gaussian elimination for the next Newton-Raphson iteration, the rows representing functions. The first n-1 columns are
-	//the Jacobian matrix of partial derivatives (each column representing a variable), and the final column is the value of -f(x) for that function
-	//This is solved to find the values of (x_n+1 - x_n)
-	double **matrix = new double*[n];
-	int i;
-	for ( i = 0; i < n; i++) matrix[i] = new double[n+1];
-
-	for ( i = 0; i < maxIter; i++) {
-		for (int j = 0; j < n; j++) {
-			VariableIdentifier varData = VariableData[j];
-			if (varData.type == VariableIdentifier::VariableType::COMPONENT) {
-				//Set the value of -f(x)
-				matrix[j][n] = -varData.component->DCFunction(this, varData.pin);
-				//Populate the matrix of derivatives
-				for (int k = 0; k < n; k++) {
-					matrix[j][k] = varData.component->DCDerivative(this, varData.pin, VariableData[k]);
-				}
-			}
-			else {
-				//Set the value of -f(x)
-				matrix[j][n] = -varData.net->DCFunction(this);
-				//Populate the matrix of derivatives
-				for (int k = 0; k < n; k++) {
-					matrix[j][k] = varData.net->DCDerivative(this, VariableData[k]);
-
-				}
-
-			}
-		}
-
-
-		worstTol = 0;
-		for (int j = 0; j < n; j++) {
-			if (abs(matrix[j][n]) > worstTol)
-				worstTol = abs(matrix[j][n]);
-		}
-		if (worstTol < tol) break;
-		//Call the Newton-Raphson solver, which updates VariableValues with their new values
-		Math::newtonIteration(n, &(VariableValues[0]), matrix);
-
-	}
-	for (int j = 0; j < n; j++) delete matrix[j];
-	delete[] matrix;
-	//If conventional Newton's method solution to find the operating point fails
-	//Fixed nets are ramped up from zero volts to full in 10% steps in an attempt to find the operating point
-	//This works to prevent convergence failures in unstable circuits such as oscillators
-	if ((i == maxIter) && (worstTol > 1)) {
-		if (attemptRamp) {
-
-			std::cerr << "WARNING: DC simulation failed to converge (error=" << worstTol << ")" << std::endl;
-			std::map<Net *, double> netVoltages;
-			for each(auto net in SolverCircuit->Nets) {
-				if ((net->IsFixedVoltage) && (net->NetVoltage != 0)) {
-					netVoltages[net] = net->NetVoltage;
-					net->NetVoltage = 0;
-				}
-			}
-			for (int j = 0; j < VariableValues.size(); j++) {
-				VariableValues[j] = 0;
-			}
-			Solve(tol, maxIter, false);
-			TransientSolver rampSolver(*this);
-			int ticks;
-			ticks = rampSolver.RampUp(netVoltages);
-			for (int j = 0; j < VariableValues.size(); j++) {
-				VariableValues[j] = rampSolver.GetVarValue(j, ticks - 1);
-			}
-		}
-		else {
-			std::cerr << "WARNING: DC Ramp analysis OP failed to converge (error=" << worstTol << ")" << std::endl;
-			return false;
-		}
-	}
-	return true;
-}
-
-double DCSolver::GetNetVoltage(Net *n) {
-	if (n->IsFixedVoltage) {
-		return n->NetVoltage;
-	}
-	else {
-		return VariableValues[NetVariables[n]];
-	}
-}
-
-
-double DCSolver::GetPinCurrent(Component *c, int pin) {
-	if (pin < c->GetNumberOfPins() - 1) {
-		NetConnection conn;
-		conn.component = c;
-		conn.pin = pin;
-		return VariableValues[ComponentVariables[c] + pin];
-	}
-	else {
-		double sum = 0;
-		for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
-			sum += GetPinCurrent(c, i);
-		}
-		return -sum;
-	}
-}
-
+#include "DCSolver.h"
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+bool VariableIdentifier::operator==(const VariableIdentifier& other)const {
+	if (type == other.type) {
+		if (type == VariableType::COMPONENT) {
+			return ((component == other.component) && (pin == other.pin));
+		}
+		else {
+			return (net == other.net);
+		}
+	}
+	return false;
+}
+
+DCSolver::DCSolver(Circuit *circuit) {
+	SolverCircuit = circuit;
+	for (auto n = circuit->Nets.begin(); n != circuit->Nets.end(); ++n) {
+		AddNet(*n);
+	}
+	for (auto c = circuit->Components.begin(); c != circuit->Components.end(); ++c) {
+		AddComponent(*c);
+	}
+	BuildJacobianPattern();
+}
+
+void DCSolver::AddComponent(Component *c) {
+	//Due to Kirchoff's Laws, for a component with n pins we only need n-1 equations
+
+	c->FirstVariable = nextFreeVariable;
+	nextFreeVariable += c->GetNumberOfPins() - 1;
+
+	for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
+		VariableValues.push_back(0.1);
+		VariableData.push_back(c->getComponentVariableIdentifier(i));
+	}
+	//Nets are always added first, so their variables are known
+	c->PinVariables.clear();
+	for (int i = 0; i < c->GetNumberOfPins(); i++) {
+		c->PinVariables.push_back(c->PinConnections[i]->IsFixedVoltage ? -1 : c->PinConnections[i]->VariableIndex);
+	}
+}
+
+void DCSolver::AddNet(Net *net) {
+	if (!net->IsFixedVoltage) {
+		net->VariableIndex = nextFreeVariable;
+		VariableNets.push_back(net);
+		VariableValues.push_back(0.1);
+		VariableData.push_back(net->GetNetVariableIdentifier());
+		nextFreeVariable++;
+	}
+	else {
+		net->VariableIndex = -1;
+	}
+}
+
+//Each function only depends on a handful of variables: the pin currents and pin net voltages of a component,
+//or the pin currents of the components connected to a net. Only these entries are stored.
+void DCSolver::BuildJacobianPattern() {
+	int n = VariableValues.size();
+	//Entries as (row, column) pairs
+	std::vector<std::pair<int, int>> entries;
+	for (int j = 0; j < n; j++) {
+		VariableIdentifier varData = VariableData[j];
+		if (varData.type == VariableIdentifier::VariableType::COMPONENT) {
+			int k = varData.component->FirstVariable;
+			int npin = varData.component->GetNumberOfPins();
+			for (int pin = 0; pin < npin; pin++) {
+				if (pin < (npin - 1))
+					entries.push_back(std::make_pair(j, k + pin));
+				int netVar = varData.component->PinVariables[pin];
+				if (netVar >= 0) {
+					entries.push_back(std::make_pair(j, netVar));
+				}
+			}
+		}
+		else {
+			int ncon = varData.net->connections.size();
+			for (int k = 0; k < ncon; k++) {
+				NetConnection conn = varData.net->connections[k];
+				int npin = conn.component->GetNumberOfPins();
+				if (conn.pin < (npin - 1)) {
+					entries.push_back(std::make_pair(j, conn.component->FirstVariable + conn.pin));
+				}
+				else {
+					for (int l = 0; l < (npin - 1); l++) {
+						entries.push_back(std::make_pair(j, conn.component->FirstVariable + l));
+					}
+				}
+			}
+			//The diagonal is only used by the continuation methods, which shunt each net to a reference voltage
+			entries.push_back(std::make_pair(j, j));
+		}
+	}
+
+	Jacobian.Begin(n);
+	for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+		Jacobian.AddEntry(iter->first, iter->second);
+	}
+	Jacobian.Finalise();
+
+	Residuals.resize(n);
+
+	//Find the slots for stamping components, and the values of the constant net entries
+	ComponentStamps.clear();
+	StampSlots.clear();
+	NetSlots.clear();
+	NetJacobianValues.clear();
+	MaxStampSize = 0;
+	for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+		VariableIdentifier varData = VariableData[iter->first];
+		if (varData.type == VariableIdentifier::VariableType::NET) {
+			NetSlots.push_back(Jacobian.GetSlot(iter->first, iter->second));
+			NetJacobianValues.push_back(varData.net->DCDerivative(this, VariableData[iter->second]));
+		}
+	}
+	for (auto iter = SolverCircuit->Components.begin(); iter != SolverCircuit->Components.end(); ++iter) {
+		Component *c = *iter;
+		int npin = c->GetNumberOfPins();
+		if (npin < 2) continue;
+		ComponentStamp stamp;
+		stamp.component = c;
+		stamp.numberOfPins = npin;
+		stamp.firstVariable = c->FirstVariable;
+		stamp.firstSlot = StampSlots.size();
+		stamp.bypass = -1;
+		for (int f = 0; f < (npin - 1); f++) {
+			int row = stamp.firstVariable + f;
+			for (int pin = 0; pin < (npin - 1); pin++) {
+				StampSlots.push_back(Jacobian.GetSlot(row, stamp.firstVariable + pin));
+			}
+			for (int pin = 0; pin < npin; pin++) {
+				int netVar = c->PinVariables[pin];
+				StampSlots.push_back((netVar < 0) ? -1 : Jacobian.GetSlot(row, netVar));
+			}
+		}
+		ComponentStamps.push_back(stamp);
+		//Functions, then current derivatives, then voltage derivatives
+		int stampSize = (npin - 1) + (npin - 1) * (npin - 1) + (npin - 1) * npin;
+		if (stampSize > MaxStampSize) MaxStampSize = stampSize;
+	}
+	StampWork.resize(MaxStampSize);
+	NetDiagonalSlots.clear();
+	for (auto net = VariableNets.begin(); net != VariableNets.end(); ++net) {
+		NetDiagonalSlots.push_back(Jacobian.GetSlot((*net)->VariableIndex, (*net)->VariableIndex));
+	}
+	ShuntVoltages.assign(VariableNets.size(), 0);
+	FixedNets.clear();
+	for (auto net = SolverCircuit->Nets.begin(); net != SolverCircuit->Nets.end(); ++net) {
+		if ((*net)->IsFixedVoltage) FixedNets.push_back(*net);
+	}
+	//Stamp components in the order of their variables
+	std::sort(ComponentStamps.begin(), ComponentStamps.end(), [](const ComponentStamp &a, const ComponentStamp &b) {
+		return a.firstVariable < b.firstVariable;
+	});
+
+	//Number the variables to keep the fill-in of the LU factorisation low
+	JacobianLU.OrderColumns(Jacobian);
+}
+
+void DCSolver::Assemble() {
+	double *values = &(Jacobian.Values[0]);
+	Jacobian.Zero();
+	for (auto net = VariableNets.begin(); net != VariableNets.end(); ++net) {
+		Residuals[(*net)->VariableIndex] = -(*net)->DCFunction(this);
+	}
+	for (int k = 0; k < NetSlots.size(); k++) {
+		values[NetSlots[k]] = NetJacobianValues[k];
+	}
+	if (ShuntConductance != 0) {
+		for (int k = 0; k < VariableNets.size(); k++) {
+			int var = VariableNets[k]->VariableIndex;
+			Residuals[var] += ShuntConductance * (VariableValues[var] - ShuntVoltages[k]);
+			values[NetDiagonalSlots[k]] -= ShuntConductance;
+		}
+	}
+
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		int npin = stamp->numberOfPins;
+		double *f = &(StampWork[0]);
+		double *dfdI = f + (npin - 1);
+		double *dfdV = dfdI + (npin - 1) * (npin - 1);
+		std::fill(dfdI, dfdV + (npin - 1) * npin, 0.0);
+		stamp->component->DCStamp(this, f, dfdI, dfdV);
+
+		const int *slot = &(StampSlots[stamp->firstSlot]);
+		for (int i = 0; i < (npin - 1); i++) {
+			Residuals[stamp->firstVariable + i] = -f[i];
+			for (int pin = 0; pin < (npin - 1); pin++) {
+				values[*(slot++)] += dfdI[i * (npin - 1) + pin];
+			}
+			for (int pin = 0; pin < npin; pin++) {
+				if (*slot >= 0)
+					values[*slot] += dfdV[i * npin + pin];
+				slot++;
+			}
+		}
+	}
+}
+
+void DCSolver::LimitStep() {
+	StepLimited = false;
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		if (stamp->component->LimitStep(&(VariableValues[0]), &(Residuals[0])))
+			StepLimited = true;
+	}
+	if (StepLimited) LimitedSteps++;
+}
+
+bool DCSolver::NewtonSolve(double tol, int maxIter, double *worstTol) {
+	int n = VariableValues.size();
+	int i;
+	StepLimited = false;
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		stamp->component->ResetStepLimit();
+	}
+	*worstTol = 0;
+	for (i = 0; i < maxIter; i++) {
+		Assemble();
+		*worstTol = 0;
+		for (int j = 0; j < n; j++) {
+			if (abs(Residuals[j]) > *worstTol)
+				*worstTol = abs(Residuals[j]);
+		}
+		if ((*worstTol < tol) && (!StepLimited)) break;
+		//Find the Newton-Raphson step, and let the components limit their junction voltages before updating VariableValues
+		JacobianLU.Factorise(Jacobian);
+		JacobianLU.Solve(&(Residuals[0]));
+		if (LimitSteps) LimitStep();
+		for (int j = 0; j < n; j++) {
+			VariableValues[j] += Residuals[j];
+		}
+	}
+	LastIterations = i;
+	Iterations += i;
+	return i < maxIter;
+}
+
+bool DCSolver::ContinuationStep(double tol, int maxIter) {
+	double worstTol;
+	bool converged = false;
+	try {
+		converged = NewtonSolve(tol, maxIter, &worstTol);
+	}
+	catch (std::runtime_error *e) {
+		//A singular Jacobian part way through a step is treated as a failed step
+		delete e;
+	}
+	ContinuationSteps++;
+	return converged;
+}
+
+void DCSolver::SetGmin(double lambda) {
+	ShuntConductance = GminStart * pow(GminEnd / GminStart, lambda);
+	std::fill(ShuntVoltages.begin(), ShuntVoltages.end(), 0.0);
+}
+
+void DCSolver::SetSourceScale(double lambda) {
+	for (int k = 0; k < FixedNets.size(); k++) {
+		FixedNets[k]->NetVoltage = lambda * FixedVoltages[k];
+	}
+}
+
+/*
+Solve a series of problems from one that is easy to solve (lambda=0) to the one wanted (lambda=1), starting each from
+the solution of the last. The step in lambda doubles after a step that converges quickly, and quarters after one that
+fails, in which case the last solution is restored and the step tried again.
+*/
+bool DCSolver::Continuation(void (DCSolver::*setParameter)(double), double tol, double initialStep) {
+	(this->*setParameter)(0);
+	if (!ContinuationStep(tol, ContinuationMaxIter)) return false;
+	std::vector<double> lastValues = VariableValues;
+	double lambda = 0, step = initialStep;
+	while (lambda < 1) {
+		double next = std::min(1.0, lambda + step);
+		(this->*setParameter)(next);
+		if (ContinuationStep(tol, ContinuationMaxIter)) {
+			lambda = next;
+			lastValues = VariableValues;
+			if (LastIterations <= ContinuationEasyIter) step *= 2;
+		}
+		else {
+			VariableValues = lastValues;
+			step /= 4;
+			if (step < ContinuationMinStep) {
+				std::cerr << "  stalled at " << lambda << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+Pseudo-transient continuation: every net is tied to its voltage at the last step by a conductance PseudoCapacitance/h,
+as if it had a capacitor to ground and a backward Euler step of h was taken. The step grows on easy steps and shrinks on
+failures, until the capacitors no longer have any effect and the circuit has settled to its operating point.
+*/
+bool DCSolver::PseudoTransient(double tol) {
+	double h = PseudoInitialStep;
+	std::vector<double> lastValues = VariableValues;
+	for (int k = 0; k < VariableNets.size(); k++) {
+		ShuntVoltages[k] = VariableValues[VariableNets[k]->VariableIndex];
+	}
+	while ((PseudoCapacitance / h) > GminEnd) {
+		ShuntConductance = PseudoCapacitance / h;
+		if (ContinuationStep(tol, ContinuationMaxIter)) {
+			lastValues = VariableValues;
+			for (int k = 0; k < VariableNets.size(); k++) {
+				ShuntVoltages[k] = VariableValues[VariableNets[k]->VariableIndex];
+			}
+			if (LastIterations <= ContinuationEasyIter) h *= 2;
+		}
+		else {
+			VariableValues = lastValues;
+			h /= 4;
+			if (h < PseudoMinStep) {
+				std::cerr << "  stalled at h=" << h << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool DCSolver::Solve(double tol, int maxIter, bool attemptContinuation) {
+	int n = VariableValues.size();
+	double worstTol = 0;
+
+	Iterations = 0;
+	LimitedSteps = 0;
+	ContinuationSteps = 0;
+	ShuntConductance = 0;
+	NewtonSolve(tol, maxIter, &worstTol);
+	if (attemptContinuation && (JacobianLU.GetFactorNonZeroCount() > 0)) {
+		std::cerr << "Jacobian: " << n << " variables, " << Jacobian.GetNonZeroCount() << " nonzeros, "
+			<< JacobianLU.GetFactorNonZeroCount() << " nonzeros in LU factors (fill ratio "
+			<< (JacobianLU.GetFactorNonZeroCount() / (double)Jacobian.GetNonZeroCount()) << ")" << std::endl;
+	}
+	/*
+	If conventional Newton's method fails to find the operating point, continuation methods are tried in turn, each
+	starting from the initial guess: gmin stepping, then source stepping, then pseudo-transient continuation. The
+	last is the most robust for unstable circuits such as oscillators and latches, but the slowest.
+	*/
+	bool converged = !((LastIterations == maxIter) && (worstTol > 1));
+	if ((!converged) && attemptContinuation) {
+		std::cerr << "WARNING: DC simulation failed to converge (error=" << worstTol << ")" << std::endl;
+		std::vector<double> initialValues(n, 0.1);
+		FixedVoltages.clear();
+		for (auto net = FixedNets.begin(); net != FixedNets.end(); ++net) {
+			FixedVoltages.push_back((*net)->NetVoltage);
+		}
+
+		if (GminStepping) {
+			std::cerr << "Trying gmin stepping" << std::endl;
+			VariableValues = initialValues;
+			if (Continuation(&DCSolver::SetGmin, tol, GminInitialStep)) {
+				ShuntConductance = 0;
+				converged = ContinuationStep(tol, maxIter);
+			}
+			ShuntConductance = 0;
+		}
+
+		if ((!converged) && SourceStepping) {
+			std::cerr << "Trying source stepping" << std::endl;
+			VariableValues = initialValues;
+			converged = Continuation(&DCSolver::SetSourceScale, tol, SourceInitialStep);
+			SetSourceScale(1);
+		}
+
+		if ((!converged) && PseudoTransientContinuation) {
+			std::cerr << "Trying pseudo-transient continuation" << std::endl;
+			VariableValues = initialValues;
+			if (PseudoTransient(tol)) {
+				ShuntConductance = 0;
+				converged = ContinuationStep(tol, maxIter);
+			}
+			ShuntConductance = 0;
+		}
+
+		if (!converged) {
+			std::cerr << "WARNING: DC continuation failed to find the operating point" << std::endl;
+		}
+	}
+	if (attemptContinuation && (JacobianLU.GetFactorNonZeroCount() > 0)) {
+		std::cerr << "DC operating point: " << Iterations << " iterations, " << LimitedSteps << " steps limited";
+		if (ContinuationSteps > 0)
+			std::cerr << ", " << ContinuationSteps << " continuation steps";
+		std::cerr << std::endl;
+	}
+	return converged;
+}
+
+double DCSolver::GetNetVoltage(Net *net, int n) {
+	if (net->IsFixedVoltage) {
+		return net->NetVoltage;
+	}
+	else {
+		return VariableValues[net->VariableIndex];
+	}
+}
+
+
+double DCSolver::GetPinCurrent(Component *c, int pin, int n) {
+	int npin = c->GetNumberOfPins();
+	if (pin < npin - 1) {
+		return VariableValues[c->FirstVariable + pin];
+	}
+	else {
+		double sum = 0;
+		for (int i = 0; i < npin - 1; i++) {
+			sum += VariableValues[c->FirstVariable + i];
+		}
+		return -sum;
+	}
+}
+
+int DCSolver::GetCurrentTick() {
+	return 0;
+}
+
+double DCSolver::GetTimeAtTick(int n) {
+	return 0;
+}
+
+double DCSolver::GetTimestep() {
+	return std::numeric_limits<double>::infinity();
+}
+
+void DCSolver::RequestTimestep(double deltaT) {
+
+}
+
+void DCSolver::InvalidateTickStamps() {
+
+}
+
+bool DCSolver::IsLinearBlock() {
+	return false;
+}
+
+int DCSolver::GetIntegrationOrder() {
+	return 0;
+}
+
+double DCSolver::GetIntegrationCoefficient(int k) {
+	return 0;
+}
+
+double DCSolver::GetDerivativeWeight(int k) {
+	return 0;
+}
+
+void DCSolver::ReportRinging() {
+
+}
+
+void DCSolver::SetNetVoltageGuess(Net *net, double value) {
+	VariableValues[net->VariableIndex] = value;
+}
+
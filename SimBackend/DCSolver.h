@@ -1,76 +1,203 @@
-#pragma once
-class Net;
-struct netConnection;
-class Component;
-class Circuit;
-
-class TransientSolver;
-
-#include <string>
-#include <vector>
-
-#include "TransientSolver.h"
-
-#include "Math.h"
-
-#include "Component.h"
-#include "Net.h"
-/*
-DC Operating point solver
-
-This solver, given a set of components and nets, returns a solution for the steady-state conditions of a circuit
-
-ALL PIN NUMBERS START FROM 0
-*/
-
-//This class is used to identify the type of a variable
-struct VariableIdentifier {
-public:
-	enum VariableType {
-		COMPONENT,
-		NET
-	} type;
-	Component *component;
-	int pin;
-	Net *net;
-
-	bool operator==(VariableIdentifier& other)const;
-};
-
-class DCSolver
-{
-	friend TransientSolver;
-public:
-	DCSolver(Circuit *circuit);
-
-
-	//Run a solve routine, returning whether or not successful
-	bool Solve(double tol = 1e-8, int maxIter = 200, bool attemptRamp = true);
-
-	//Get value of a net voltage at current point in solve routine
-	double GetNetVoltage(Net *net);
-
-	//Get value of current going INTO a pin at current point in solve routine
-	double GetPinCurrent(Component *c, int pin);
-	Circuit *SolverCircuit;
-
-private:
-	int nextFreeVariable = 0;
-
-	//Add components and nets to be included in the solver
-	void AddComponent(Component *c);
-	void AddNet(Net *net);
-
-
-	std::map<Net *, int> NetVariables; //Map pointers to nets to net voltage variable IDs
-
-	//Note that there are n-1 (where n=number of pins) variables allocated to each component
-	std::map<Component *, int> ComponentVariables; //Map component pins to pin current variable IDs
-
-	std::map<int, VariableIdentifier> VariableData; //Allow variables to be looked up
-
-	std::vector<double> VariableValues; //Map variable IDs to values
-
-};
-
-#include "Circuit.h"
+#pragma once
+class Net;
+struct netConnection;
+class Component;
+class Circuit;
+
+class TransientSolver;
+
+#include <string>
+#include <vector>
+
+#include "TransientSolver.h"
+
+#include "Math.h"
+#include "SparseLU.h"
+
+#include "Component.h"
+#include "Net.h"
+/*
+DC Operating point solver
+
+This solver, given a set of components and nets, returns a solution for the steady-state conditions of a circuit
+
+ALL PIN NUMBERS START FROM 0
+*/
+
+//This class is used to identify the type of a variable
+struct VariableIdentifier {
+public:
+	enum VariableType {
+		COMPONENT,
+		NET
+	} type;
+	Component *component;
+	int pin;
+	Net *net;
+
+	bool operator==(const VariableIdentifier& other)const;
+};
+
+/*
+Where a component's functions and derivatives go in the Jacobian, so that it can be stamped in one call
+
+For a component with n pins, each of its n-1 functions has a block of 2n-1 slots: one for the current of each of
+pins 0 to n-2, then one for the voltage of the net on each pin 0 to n-1 (-1 if the net is fixed voltage)
+*/
+struct ComponentStamp {
+	Component *component;
+	int numberOfPins;
+	int firstVariable; //Variable, and function, of pin 0
+	int firstSlot; //Index into StampSlots of the first slot of function 0
+	int bypass; //Index of the component's bypass state in the transient solver, or -1 if it is never bypassed
+};
+
+class DCSolver
+{
+	friend TransientSolver;
+public:
+	DCSolver(Circuit *circuit);
+
+
+	//Run a solve routine, returning whether or not successful. If Newton's method fails, continuation methods are tried unless attemptContinuation is false
+	bool Solve(double tol = 1e-8, int maxIter = 200, bool attemptContinuation = true);
+
+	/*
+	Components are evaluated with the same stamps as in the transient solver (see Component::TransientStamp), so the DC
+	solver provides the methods of the transient solver that they use. These take their meaning at the operating point:
+	there is a single point, so the tick n is ignored, and the timestep is infinite.
+	*/
+
+	//Get value of a net voltage at current point in solve routine
+	double GetNetVoltage(Net *net, int n = -1);
+
+	//Get value of current going INTO a pin at current point in solve routine
+	double GetPinCurrent(Component *c, int pin, int n = -1);
+
+	//Always tick 0 at time 0
+	int GetCurrentTick();
+	double GetTimeAtTick(int n);
+
+	//Returns infinity, which components check for where their DC behaviour differs
+	double GetTimestep();
+
+	//These have no effect on the DC solver
+	void RequestTimestep(double deltaT);
+	void InvalidateTickStamps();
+
+	//Always false, as the circuit is solved as a whole
+	bool IsLinearBlock();
+
+	//There is no integration at the operating point, so these return 0 and ReportRinging has no effect
+	int GetIntegrationOrder();
+	double GetIntegrationCoefficient(int k);
+	double GetDerivativeWeight(int k);
+	void ReportRinging();
+
+	//Sets the guess value for a net voltage
+	void SetNetVoltageGuess(Net *net, double value);
+	Circuit *SolverCircuit;
+
+	//Limit the junction voltages of each Newton-Raphson step as the transient solver does (see TransientSolver::LimitSteps)
+	bool LimitSteps = true;
+
+	//Number of iterations taken by the last solve, and the number of steps where any component was limited
+	int Iterations = 0;
+	int LimitedSteps = 0;
+
+	//Number of Newton-Raphson solves done by the continuation methods in the last solve
+	int ContinuationSteps = 0;
+
+	/*
+	Continuation settings. Each continuation step is a Newton-Raphson solve of up to ContinuationMaxIter iterations,
+	and a step taking no more than ContinuationEasyIter iterations lets the next step be twice as large.
+
+	Gmin stepping shunts every net to ground, with a conductance stepped from GminStart down to GminEnd in log scale.
+	Source stepping scales every fixed voltage net from 0 to its full voltage.
+	Pseudo-transient continuation gives every net a capacitance of PseudoCapacitance to its last voltage, with the
+	timestep starting at PseudoInitialStep and growing until the shunt conductance is below GminEnd.
+	*/
+	bool GminStepping = true;
+	bool SourceStepping = true;
+	bool PseudoTransientContinuation = true;
+	int ContinuationMaxIter = 50;
+	int ContinuationEasyIter = 10;
+	double GminStart = 1e-2;
+	double GminEnd = 1e-12;
+	double GminInitialStep = 0.1;
+	double SourceInitialStep = 0.1;
+	double ContinuationMinStep = 1e-4;
+	double PseudoCapacitance = 1e-6;
+	double PseudoInitialStep = 1e-6;
+	double PseudoMinStep = 1e-15;
+
+private:
+	int nextFreeVariable = 0;
+
+	//Add components and nets to be included in the solver
+	void AddComponent(Component *c);
+	void AddNet(Net *net);
+
+
+	/*
+	Each net and component records the variables it has been given (see Net::VariableIndex and Component::FirstVariable),
+	so finding a variable is an array lookup.
+	Note that there are n-1 (where n=number of pins) variables allocated to each component
+	*/
+	std::vector<Net *> VariableNets; //Nets with a voltage variable
+
+	std::vector<VariableIdentifier> VariableData; //Allow variables to be looked up
+
+	std::vector<double> VariableValues; //Map variable IDs to values
+
+	//Sparse Jacobian matrix, with its pattern built once from the circuit and filled in place during each iteration
+	SparseMatrix Jacobian;
+	SparseLU JacobianLU;
+	std::vector<double> Residuals; //Value of -f(x) for each function
+
+	std::vector<ComponentStamp> ComponentStamps;
+	std::vector<int> StampSlots;
+
+	//The Kirchoff function of a net is linear, so its derivatives are found once. NetSlots holds the slot of each entry of the net rows
+	std::vector<int> NetSlots;
+	std::vector<double> NetJacobianValues;
+
+	int MaxStampSize = 0; //Space needed to stamp the component with the most pins
+	std::vector<double> StampWork; //Functions and derivatives of the component being stamped
+
+	//Build the sparsity pattern of the Jacobian from the nets and components in the circuit, and choose a column order for it
+	void BuildJacobianPattern();
+
+	//Evaluate -f(x) into Residuals and the Jacobian at the current point, stamping each component once
+	void Assemble();
+
+	//Pass the step in Residuals to the components to limit, before it is taken
+	void LimitStep();
+	bool StepLimited = false; //Whether any component was limited at the last step
+
+	//Run Newton's method from the current point, returning whether it converged, and the worst residual in worstTol
+	bool NewtonSolve(double tol, int maxIter, double *worstTol);
+	int LastIterations = 0; //Number of iterations taken by the last NewtonSolve
+
+	//Run NewtonSolve for a continuation step, treating a singular Jacobian as a failure to converge
+	bool ContinuationStep(double tol, int maxIter);
+
+	//Step a continuation parameter from 0 to 1 with an adaptive step, returning whether the solve at 1 converged
+	bool Continuation(void (DCSolver::*setParameter)(double), double tol, double initialStep);
+	bool PseudoTransient(double tol);
+
+	//Set the continuation parameter for gmin and source stepping
+	void SetGmin(double lambda);
+	void SetSourceScale(double lambda);
+
+	//A conductance from each net to ShuntVoltages, used by gmin stepping and pseudo-transient continuation
+	double ShuntConductance = 0;
+	std::vector<double> ShuntVoltages; //Indexed as VariableNets
+	std::vector<int> NetDiagonalSlots; //Slot of the diagonal entry of each net in VariableNets
+
+	std::vector<Net *> FixedNets;
+	std::vector<double> FixedVoltages; //Full voltage of each fixed net, for source stepping
+
+};
+
+#include "Circuit.h"
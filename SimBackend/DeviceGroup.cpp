@@ -0,0 +1,302 @@
+#include "DeviceGroup.h"
+#include "DiscreteSemis.h"
+#include "DCSolver.h"
+#include "Math.h"
+
+DeviceGroup::DeviceGroup(int pins) {
+	Pins = pins;
+	Current.resize(pins - 1);
+	Voltage.resize(pins);
+	F.resize(pins - 1);
+	DfdI.resize((pins - 1) * (pins - 1));
+	DfdV.resize((pins - 1) * pins);
+	PinVariable.resize(pins);
+	PinNet.resize(pins);
+	Slots.resize((pins - 1) * (2 * pins - 1));
+}
+
+DeviceGroup::~DeviceGroup() {
+
+}
+
+DeviceGroup *DeviceGroup::Create(const std::string &type) {
+	if (type == "D")
+		return new DiodeGroup();
+	if (type == "BJT")
+		return new BJTGroup();
+	if (type == "NMOS")
+		return new NMOSGroup();
+	return nullptr;
+}
+
+void DeviceGroup::Add(const ComponentStamp &stamp, const int *slots) {
+	Component *c = stamp.component;
+	Devices.push_back(c);
+	FirstVariable.push_back(stamp.firstVariable);
+	for (int p = 0; p < Pins; p++) {
+		PinVariable[p].push_back(c->PinVariables[p]);
+		PinNet[p].push_back(c->PinConnections[p]);
+		Voltage[p].push_back(0);
+	}
+	for (int p = 0; p < (Pins - 1); p++) {
+		Current[p].push_back(0);
+		F[p].push_back(0);
+	}
+	for (auto d = DfdI.begin(); d != DfdI.end(); ++d) d->push_back(0);
+	for (auto d = DfdV.begin(); d != DfdV.end(); ++d) d->push_back(0);
+	for (int k = 0; k < Slots.size(); k++) {
+		Slots[k].push_back(slots[k]);
+	}
+	Size++;
+	Resize();
+}
+
+void DeviceGroup::Evaluate(const double *x, double *residuals, double *jacobian) {
+	for (int p = 0; p < (Pins - 1); p++) {
+		double *current = &(Current[p][0]);
+		for (int d = 0; d < Size; d++) {
+			current[d] = x[FirstVariable[d] + p];
+		}
+	}
+	for (int p = 0; p < Pins; p++) {
+		double *voltage = &(Voltage[p][0]);
+		const int *var = &(PinVariable[p][0]);
+		for (int d = 0; d < Size; d++) {
+			voltage[d] = (var[d] < 0) ? PinNet[p][d]->NetVoltage : x[var[d]];
+		}
+	}
+
+	Compute(jacobian != nullptr);
+
+	if (residuals != nullptr) {
+		for (int i = 0; i < (Pins - 1); i++) {
+			const double *f = &(F[i][0]);
+			for (int d = 0; d < Size; d++) {
+				residuals[FirstVariable[d] + i] = -f[d];
+			}
+		}
+	}
+	if (jacobian != nullptr) {
+		int entry = 0;
+		for (int i = 0; i < (Pins - 1); i++) {
+			for (int k = 0; k < (2 * Pins - 1); k++) {
+				const double *value = (k < (Pins - 1)) ? &(DfdI[i * (Pins - 1) + k][0]) : &(DfdV[i * Pins + k - (Pins - 1)][0]);
+				const int *slot = &(Slots[entry++][0]);
+				for (int d = 0; d < Size; d++) {
+					if (slot[d] >= 0)
+						jacobian[slot[d]] += value[d];
+				}
+			}
+		}
+	}
+}
+
+int DeviceGroup::GetSize() const {
+	return Size;
+}
+
+DiodeGroup::DiodeGroup() : DeviceGroup(2) {
+
+}
+
+void DiodeGroup::Resize() {
+	SaturationCurrent.resize(Size);
+	SeriesResistance.resize(Size);
+	ThermalVoltage.resize(Size);
+	X.resize(Size);
+	E.resize(Size);
+	dE.resize(Size);
+	Offset.resize(Size);
+}
+
+void DiodeGroup::UpdateParameters() {
+	for (int d = 0; d < Size; d++) {
+		Diode *diode = (Diode *)Devices[d];
+		SaturationCurrent[d] = diode->SaturationCurrent;
+		SeriesResistance[d] = diode->SeriesResistance;
+		ThermalVoltage[d] = diode->IdealityFactor * Math::vTherm;
+	}
+}
+
+void DiodeGroup::Compute(bool derivatives) {
+	const double *I = &(Current[0][0]);
+	const double *V0 = &(Voltage[0][0]);
+	const double *V1 = &(Voltage[1][0]);
+	for (int d = 0; d < Size; d++) {
+		double Vj = (V0[d] - V1[d]) - SeriesResistance[d] * I[d];
+		const Diode *diode = (const Diode *)Devices[d];
+		double Vlin = diode->StepLimited ? diode->LimitedVoltage : Vj;
+		X[d] = Vlin / ThermalVoltage[d];
+		Offset[d] = Vj - Vlin;
+	}
+	Math::exp_safe_batch(&(X[0]), &(E[0]), &(dE[0]), Size);
+	double *f = &(F[0][0]);
+	for (int d = 0; d < Size; d++) {
+		f[d] = SaturationCurrent[d] * (E[d] - 1) - I[d];
+		if (Offset[d] != 0)
+			f[d] += SaturationCurrent[d] * (1 / ThermalVoltage[d]) * dE[d] * Offset[d];
+	}
+	if (!derivatives) return;
+	double *dfdI = &(DfdI[0][0]);
+	double *dfdV0 = &(DfdV[0][0]);
+	double *dfdV1 = &(DfdV[1][0]);
+	for (int d = 0; d < Size; d++) {
+		double g = SaturationCurrent[d] * (1 / ThermalVoltage[d]) * dE[d];
+		dfdI[d] = -SeriesResistance[d] * g - 1;
+		dfdV0[d] = g;
+		dfdV1[d] = -g;
+	}
+}
+
+BJTGroup::BJTGroup() : DeviceGroup(3) {
+
+}
+
+void BJTGroup::Resize() {
+	ForwardGain.resize(Size);
+	ReverseGain.resize(Size);
+	SaturationCurrent.resize(Size);
+	Rcollector.resize(Size);
+	Rbase.resize(Size);
+	Remitter.resize(Size);
+	Vt.resize(Size);
+	X.resize(2 * Size);
+	E.resize(2 * Size);
+	dE.resize(2 * Size);
+	Offset.resize(2 * Size);
+}
+
+void BJTGroup::UpdateParameters() {
+	for (int d = 0; d < Size; d++) {
+		BJT *bjt = (BJT *)Devices[d];
+		ForwardGain[d] = bjt->ForwardGain;
+		ReverseGain[d] = bjt->ReverseGain;
+		SaturationCurrent[d] = bjt->SaturationCurrent;
+		Rcollector[d] = bjt->Rcollector;
+		Rbase[d] = bjt->Rbase;
+		Remitter[d] = bjt->Remitter;
+		Vt[d] = bjt->GetVt();
+	}
+}
+
+void BJTGroup::Compute(bool derivatives) {
+	const double *Ic = &(Current[0][0]);
+	const double *Ib = &(Current[1][0]);
+	const double *Vc = &(Voltage[0][0]);
+	const double *Vb = &(Voltage[1][0]);
+	const double *Ve = &(Voltage[2][0]);
+	for (int d = 0; d < Size; d++) {
+		double Ie = -(Ic[d] + Ib[d]);
+		double VbInternal = Vb[d] - Rbase[d] * Ib[d];
+		double Vbe = VbInternal - (Ve[d] - Remitter[d] * Ie);
+		double Vbc = VbInternal - (Vc[d] - Rcollector[d] * Ic[d]);
+		const BJT *bjt = (const BJT *)Devices[d];
+		double VbeLin = bjt->StepLimited ? bjt->LimitedVbe : Vbe;
+		double VbcLin = bjt->StepLimited ? bjt->LimitedVbc : Vbc;
+		X[d] = VbeLin / Vt[d];
+		X[Size + d] = VbcLin / Vt[d];
+		Offset[d] = Vbe - VbeLin;
+		Offset[Size + d] = Vbc - VbcLin;
+	}
+	Math::exp_safe_batch(&(X[0]), &(E[0]), &(dE[0]), 2 * Size);
+	const double *Ebe = &(E[0]);
+	const double *Ebc = &(E[Size]);
+	double *f0 = &(F[0][0]);
+	double *f1 = &(F[1][0]);
+	for (int d = 0; d < Size; d++) {
+		f0[d] = SaturationCurrent[d] * ((Ebe[d] - Ebc[d]) - (1 / ReverseGain[d]) * (Ebc[d] - 1)) - Ic[d];
+		f1[d] = SaturationCurrent[d] * ((1 / ForwardGain[d]) * (Ebe[d] - 1) + (1 / ReverseGain[d]) * (Ebc[d] - 1)) - Ib[d];
+		if ((Offset[d] != 0) || (Offset[Size + d] != 0)) {
+			double Gbe = SaturationCurrent[d] * dE[d] / Vt[d];
+			double Gbc = SaturationCurrent[d] * dE[Size + d] / Vt[d];
+			f0[d] += Gbe * Offset[d] - Gbc * (1 + 1 / ReverseGain[d]) * Offset[Size + d];
+			f1[d] += (Gbe / ForwardGain[d]) * Offset[d] + (Gbc / ReverseGain[d]) * Offset[Size + d];
+		}
+	}
+	if (!derivatives) return;
+	for (int d = 0; d < Size; d++) {
+		double Gbe = SaturationCurrent[d] * dE[d] / Vt[d];
+		double Gbc = SaturationCurrent[d] * dE[Size + d] / Vt[d];
+		//Derivatives of each function with respect to Vbe and Vbc, as in BJT::TransientStamp
+		double dVbe[2] = { Gbe, Gbe / ForwardGain[d] };
+		double dVbc[2] = { -Gbc * (1 + 1 / ReverseGain[d]), Gbc / ReverseGain[d] };
+		for (int i = 0; i < 2; i++) {
+			DfdI[i * 2 + 0][d] = dVbe[i] * -Remitter[d] + dVbc[i] * Rcollector[d];
+			DfdI[i * 2 + 1][d] = dVbe[i] * (-Rbase[d] - Remitter[d]) + dVbc[i] * -Rbase[d];
+			DfdV[i * 3 + 0][d] = -dVbc[i];
+			DfdV[i * 3 + 1][d] = dVbe[i] + dVbc[i];
+			DfdV[i * 3 + 2][d] = -dVbe[i];
+		}
+		DfdI[0][d] -= 1;
+		DfdI[3][d] -= 1;
+	}
+}
+
+NMOSGroup::NMOSGroup() : DeviceGroup(3) {
+
+}
+
+void NMOSGroup::Resize() {
+	K.resize(Size);
+	lambda.resize(Size);
+	Vth.resize(Size);
+	Rgs.resize(Size);
+}
+
+void NMOSGroup::UpdateParameters() {
+	for (int d = 0; d < Size; d++) {
+		NMOS *nmos = (NMOS *)Devices[d];
+		K[d] = nmos->K;
+		lambda[d] = nmos->lambda;
+		Vth[d] = nmos->Vth;
+		Rgs[d] = nmos->Rgs;
+	}
+}
+
+void NMOSGroup::Compute(bool derivatives) {
+	const double *Is = &(Current[0][0]);
+	const double *Ig = &(Current[1][0]);
+	const double *Vs = &(Voltage[0][0]);
+	const double *Vg = &(Voltage[1][0]);
+	const double *Vd = &(Voltage[2][0]);
+	for (int d = 0; d < Size; d++) {
+		double Vgs = Vg[d] - Vs[d];
+		double Vds = Vd[d] - Vs[d];
+		const NMOS *nmos = (const NMOS *)Devices[d];
+		double VgsLin = nmos->StepLimited ? nmos->LimitedVgs : Vgs;
+		double VdsLin = nmos->StepLimited ? nmos->LimitedVds : Vds;
+
+		//Drain current and its derivatives with respect to Vgs and Vds, as in NMOS::TransientStamp
+		double Id = 0, dIdVgs = 0, dIdVds = 0;
+		if (VgsLin >= Vth[d]) {
+			double modulation = 1 + lambda[d] * fabs(VdsLin);
+			double dModulation = (VdsLin < 0) ? -lambda[d] : lambda[d];
+			if (VdsLin < (VgsLin - Vth[d])) {
+				double A = (VgsLin - Vth[d]) * VdsLin - (pow(VdsLin, 2) / 2);
+				Id = K[d] * A * modulation;
+				dIdVgs = K[d] * VdsLin * modulation;
+				dIdVds = K[d] * ((VgsLin - Vth[d] - VdsLin) * modulation + A * dModulation);
+			}
+			else {
+				Id = (K[d] / 2) * pow(VgsLin - Vth[d], 2) * modulation;
+				dIdVgs = K[d] * (VgsLin - Vth[d]) * modulation;
+				dIdVds = (K[d] / 2) * pow(VgsLin - Vth[d], 2) * dModulation;
+			}
+		}
+		if (nmos->StepLimited) Id += dIdVgs * (Vgs - VgsLin) + dIdVds * (Vds - VdsLin);
+
+		F[0][d] = (Id + Ig[d]) + Is[d];
+		F[1][d] = Ig[d] - (1.0 / Rgs[d]) * Vgs;
+		if (derivatives) {
+			DfdI[0][d] = 1;
+			DfdI[1][d] = 1;
+			DfdV[0][d] = -dIdVgs - dIdVds;
+			DfdV[1][d] = dIdVgs;
+			DfdV[2][d] = dIdVds;
+
+			DfdI[3][d] = 1;
+			DfdV[3][d] = 1.0 / Rgs[d];
+			DfdV[4][d] = -1.0 / Rgs[d];
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include <string>
+class Component;
+class Net;
+struct ComponentStamp;
+/*
+Devices of one type in a block of the transient solver, evaluated together instead of through a virtual call each
+
+The parameters, variables and Jacobian slots of the devices are stored as structures of arrays, with one array for
+each quantity holding an entry per device, so each step of a device model is a loop over every device in the group.
+The exponentials in the diode and BJT models are found using Math::exp_safe_batch, which works on four or eight
+devices per instruction when built with AVX2 or AVX-512. The remaining loops are left for the compiler to vectorise.
+
+The functions and derivatives are the same as those of the device's TransientStamp, including its linearisation about
+limited voltages (see Component::LimitStep). Devices in a group are never bypassed, as evaluating the group costs less
+than checking each device against its bypass tolerance.
+*/
+class DeviceGroup
+{
+public:
+	DeviceGroup(int pins);
+	virtual ~DeviceGroup();
+
+	//Create an empty group for devices of a given component type, or return nullptr if the type cannot be grouped
+	static DeviceGroup *Create(const std::string &type);
+
+	//Add a device given its stamp, and the slots of the stamp in the Jacobian
+	void Add(const ComponentStamp &stamp, const int *slots);
+
+	//Read the parameters of every device again, after they have been changed
+	virtual void UpdateParameters() = 0;
+
+	/*
+	Evaluate every device at the variable values x. If residuals is not null, -f is written to the row of each function,
+	and if jacobian is not null the derivatives are added to the Jacobian values
+	*/
+	void Evaluate(const double *x, double *residuals, double *jacobian);
+
+	//Get the number of devices in the group
+	int GetSize() const;
+
+protected:
+	int Pins;
+	int Size = 0;
+	std::vector<Component *> Devices;
+
+	//Pin currents (pins 0 to n-2) and pin voltages of every device at the point being evaluated, as [pin][device]
+	std::vector<std::vector<double>> Current, Voltage;
+
+	//Functions and derivatives of every device, laid out as for TransientStamp with an array of devices for each entry
+	std::vector<std::vector<double>> F, DfdI, DfdV;
+
+	//Add space for the state of one more device, before its parameters are read
+	virtual void Resize() = 0;
+
+	//Find F, and DfdI and DfdV if derivatives is set, from Current and Voltage
+	virtual void Compute(bool derivatives) = 0;
+
+private:
+	std::vector<int> FirstVariable;
+	std::vector<std::vector<int>> PinVariable; //[pin][device], or -1 where the net is fixed voltage
+	std::vector<std::vector<Net *>> PinNet;
+	std::vector<std::vector<int>> Slots; //[entry][device], in the same order as StampSlots
+};
+
+class DiodeGroup :
+	public DeviceGroup
+{
+public:
+	DiodeGroup();
+	void UpdateParameters();
+
+protected:
+	void Resize();
+	void Compute(bool derivatives);
+
+private:
+	std::vector<double> SaturationCurrent, SeriesResistance;
+	std::vector<double> ThermalVoltage; //Thermal voltage times ideality factor
+	std::vector<double> X, E, dE; //Argument of the exponential, and exp_safe and exp_deriv of it
+	std::vector<double> Offset; //Junction voltage less the voltage the model is linearised about, for limited devices
+};
+
+class BJTGroup :
+	public DeviceGroup
+{
+public:
+	BJTGroup();
+	void UpdateParameters();
+
+protected:
+	void Resize();
+	void Compute(bool derivatives);
+
+private:
+	std::vector<double> ForwardGain, ReverseGain, SaturationCurrent, Rcollector, Rbase, Remitter, Vt;
+	std::vector<double> X, E, dE; //Vbe / Vt for every device followed by Vbc / Vt, and exp_safe and exp_deriv of them
+	std::vector<double> Offset; //Vbe then Vbc less the voltages the model is linearised about, for limited devices
+};
+
+class NMOSGroup :
+	public DeviceGroup
+{
+public:
+	NMOSGroup();
+	void UpdateParameters();
+
+protected:
+	void Resize();
+	void Compute(bool derivatives);
+
+private:
+	std::vector<double> K, lambda, Vth, Rgs;
+};
@@ -1,81 +1,61 @@
-#include "DiscreteSemis.h"
-#include "Math.h"
-std::string Diode::GetComponentType() {
-	return "D";
-}
-
-int Diode::GetNumberOfPins() {
-	return 2;
-}
-
-void Diode::SetParameters(ParameterSet params) {
-	SaturationCurrent = params.getDouble("is", SaturationCurrent);
-	IdealityFactor = params.getDouble("n", IdealityFactor);
-	SeriesResistance = params.getDouble("rser", SeriesResistance);
-}
-
-// f0: Is * (e ^ ((Vd - IRs)/(n*Vt)) - 1) - I
-
-double Diode::DCFunction(DCSolver *solver, int f) {
-	if (f == 0) {
-		double L = SaturationCurrent *
-				(Math::exp_safe(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1])) - SeriesResistance * solver->GetPinCurrent(this, 0)) / (IdealityFactor * Math::vTherm)) - 1);
-		double R = solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double Diode::TransientFunction(TransientSolver *solver, int f) {
-	if (f == 0) {
-		double L = SaturationCurrent *
-			(Math::exp_safe(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1])) - SeriesResistance * solver->GetPinCurrent(this, 0)) / (IdealityFactor * Math::vTherm)) - 1);
-		double R = solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double Diode::DCDerivative(DCSolver *solver, int f, VariableIdentifier var) {
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * Math::exp_deriv(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * solver->GetPinCurrent(this, 0))) / (IdealityFactor*Math::vTherm));
-			}
-			else if (var.net == PinConnections[1]) {
-				return -1 * SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * Math::exp_deriv(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * solver->GetPinCurrent(this, 0))) / (IdealityFactor*Math::vTherm));
-
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return -1 * SeriesResistance * SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * Math::exp_deriv(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * solver->GetPinCurrent(this, 0))) / (IdealityFactor*Math::vTherm)) - 1;
-			}
-		}	
-	}
-	return 0;
-}
-
-double Diode::TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var) {
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * Math::exp_deriv(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * solver->GetPinCurrent(this, 0))) / (IdealityFactor*Math::vTherm));
-			}
-			else if (var.net == PinConnections[1]) {
-				return -1 * SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * Math::exp_deriv(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * solver->GetPinCurrent(this, 0))) / (IdealityFactor*Math::vTherm));
-
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return -1 * SeriesResistance * SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * Math::exp_deriv(((solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1]) - SeriesResistance * solver->GetPinCurrent(this, 0))) / (IdealityFactor*Math::vTherm)) - 1;
-			}
-		}
-	}
-	return 0;
-}
+#include "DiscreteSemis.h"
+#include "Math.h"
+std::string Diode::GetComponentType() {
+	return "D";
+}
+
+int Diode::GetNumberOfPins() {
+	return 2;
+}
+
+bool Diode::SupportsBypass() {
+	return true;
+}
+
+bool Diode::SupportsParallelEvaluation() {
+	return true;
+}
+
+void Diode::SetParameters(ParameterSet params) {
+	SaturationCurrent = params.getDouble("is", SaturationCurrent);
+	IdealityFactor = params.getDouble("n", IdealityFactor);
+	SeriesResistance = params.getDouble("rser", SeriesResistance);
+}
+
+// f0: Is * (e ^ ((Vd - IRs)/(n*Vt)) - 1) - I
+
+template <typename Solver> void Diode::Stamp(Solver *solver, double *f, double *dfdI, double *dfdV) {
+	double I = solver->GetPinCurrent(this, 0);
+	double Vj = (solver->GetNetVoltage(PinConnections[0]) - solver->GetNetVoltage(PinConnections[1])) - SeriesResistance * I;
+	//While limited, the model is linearised about the limited junction voltage (see LimitStep)
+	double Vlin = StepLimited ? LimitedVoltage : Vj;
+	double e, de;
+	Math::exp_safe_with_deriv(Vlin / (IdealityFactor * Math::vTherm), e, de);
+	double g = SaturationCurrent * (1 / (IdealityFactor*Math::vTherm)) * de;
+	f[0] = SaturationCurrent * (e - 1) - I;
+	if (StepLimited) f[0] += g * (Vj - Vlin);
+	if (dfdI == nullptr) return;
+	dfdI[0] = -SeriesResistance * g - 1;
+	dfdV[0] = g;
+	dfdV[1] = -g;
+}
+
+bool Diode::LimitStep(const double *values, const double *step) {
+	double nVt = IdealityFactor * Math::vTherm;
+	double Vj = (GetPinVoltage(values, 0) - GetPinVoltage(values, 1)) - SeriesResistance * values[FirstVariable];
+	double dVj = (GetPinVoltageStep(step, 0) - GetPinVoltageStep(step, 1)) - SeriesResistance * step[FirstVariable];
+	//The step is limited from the voltage the model was last linearised about
+	double Vold = StepLimited ? LimitedVoltage : Vj;
+	double Vnew = Vj + dVj;
+	LimitedVoltage = Math::pnjlim(Vnew, Vold, nVt, Math::pnjcrit(nVt, SaturationCurrent));
+	StepLimited = (LimitedVoltage != Vnew);
+	return StepLimited;
+}
+
+void Diode::TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
+
+void Diode::DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
@@ -1,81 +1,268 @@
-#include "Math.h"
-#include <stdexcept>
-#include <set>
-
-namespace Math {
-	void newtonIteration(int n, double *x, double **m) {
-		bool atConvergence = true;
-
-		gaussianElimination(n, m);
-		double *delta = new double[n];
-		//Back substitution: see report section 2.4.1.5
-		for (int i = n - 1; i >= 0; i--) {
-			double sum = m[i][n];
-			for (int j = i + 1; j < n; j++) {
-				sum -= delta[j] * m[i][j];
-			}
-			delta[i] = sum / m[i][i];
-		}
-
-		for (int i = 0; i < n; i++) {
-			x[i] += delta[i];
-		}
-		delete[] delta;
-
-	}
-	
-	//See report section 2.4.1.4
-	void gaussianElimination(int n, double **m) {
-		//One for each row: a list of non-zeros for each row
-
-		for (int r = 0; r < n; r++) {
-			int i_max = argmax2<int, double>([&](int x) -> double {return std::abs(m[x][r]); }, r, n - 1, 1);
-			if (m[i_max][r] == 0)
-				throw new std::runtime_error("Matrix is singular");
-
-			//Swap rows
-			double *tmpRow;
-			tmpRow = m[r];
-			m[r] = m[i_max];
-			m[i_max] = tmpRow;
-
-			for (int i = r + 1; i < n; i++) {
-				if (m[i][r] != 0) {
-					for (int j = r + 1; j < n + 1; j++) {
-						if (m[r][j] != 0) {
-							m[i][j] -= m[r][j] * (m[i][r] / m[r][r]);
-						}
-					}
-					m[i][r] = 0;
-				}
-
-			}
-		}
-	}
-
-
-
-	double exp_safe(double x, double limit) {
-		if (x > limit) {
-			return exp(limit)*(x - limit + 1);
-		}
-		else if (x < -limit) {
-			return exp(-limit)*(x + limit + 1);
-		}
-		else {
-			return exp(x);
-		}
-	}
-
-	double exp_deriv(double x, double limit) {
-		if (x > limit) {
-			return exp(limit);
-		}
-		else if (x < -limit) {
-			return exp(-limit);
-		}
-		else {
-			return exp(x);
-		}
-	}
+#include "Math.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace Math {
+	//Voltage limiting as done by SPICE 3f5 (DEVpnjlim, DEVfetlim and DEVlimvds)
+	double pnjlim(double vnew, double vold, double vt, double vcrit) {
+		if ((vnew > vcrit) && (fabs(vnew - vold) > (2 * vt))) {
+			if (vold > 0) {
+				double arg = 1 + (vnew - vold) / vt;
+				if (arg > 0)
+					return vold + vt * log(arg);
+				else
+					return vcrit;
+			}
+			else {
+				return vt * log(vnew / vt);
+			}
+		}
+		return vnew;
+	}
+
+	double pnjcrit(double vt, double is) {
+		return vt * log(vt / (sqrt(2.0) * is));
+	}
+
+	double fetlim(double vnew, double vold, double vto) {
+		double vtsthi = fabs(2 * (vold - vto)) + 2;
+		double vtstlo = vtsthi / 2 + 2;
+		double vtox = vto + 3.5;
+		double delv = vnew - vold;
+		if (vold >= vto) {
+			if (vold >= vtox) {
+				if (delv <= 0) {
+					//Going off
+					if (vnew >= vtox) {
+						if (-delv > vtstlo)
+							vnew = vold - vtstlo;
+					}
+					else {
+						vnew = fmax(vnew, vto + 2);
+					}
+				}
+				else if (delv >= vtsthi) {
+					//Staying on
+					vnew = vold + vtsthi;
+				}
+			}
+			else {
+				//Middle region
+				if (delv <= 0)
+					vnew = fmax(vnew, vto - 0.5);
+				else
+					vnew = fmin(vnew, vto + 4);
+			}
+		}
+		else {
+			//Off
+			if (delv <= 0) {
+				if (-delv > vtsthi)
+					vnew = vold - vtsthi;
+			}
+			else {
+				double vtemp = vto + 0.5;
+				if (vnew <= vtemp) {
+					if (delv > vtstlo)
+						vnew = vold + vtstlo;
+				}
+				else {
+					vnew = vtemp;
+				}
+			}
+		}
+		return vnew;
+	}
+
+	double limvds(double vnew, double vold) {
+		if (vold >= 3.5) {
+			if (vnew > vold)
+				vnew = fmin(vnew, 3 * vold + 2);
+			else if (vnew < 3.5)
+				vnew = fmax(vnew, 2.0);
+		}
+		else {
+			if (vnew > vold)
+				vnew = fmin(vnew, 4.0);
+			else
+				vnew = fmax(vnew, -0.5);
+		}
+		return vnew;
+	}
+
+	//The coefficient of x[j] is the derivative at t[0] of the Lagrange basis polynomial that is 1 at t[j] and 0 at the other times
+	void bdfCoefficients(const double *t, int order, double *a) {
+		a[0] = 0;
+		for (int m = 1; m <= order; m++) {
+			a[0] += 1 / (t[0] - t[m]);
+		}
+		for (int j = 1; j <= order; j++) {
+			double num = 1, den = 1;
+			for (int m = 0; m <= order; m++) {
+				if (m == j) continue;
+				if (m != 0) num *= (t[0] - t[m]);
+				den *= (t[j] - t[m]);
+			}
+			a[j] = num / den;
+		}
+	}
+
+	double derivativeEstimate(const double *t, const double *x, int order) {
+		double dd[16];
+		std::copy(x, x + order + 1, dd);
+		double factorial = 1;
+		for (int level = 1; level <= order; level++) {
+			for (int k = 0; k <= order - level; k++) {
+				dd[k] = (dd[k] - dd[k + 1]) / (t[k] - t[k + level]);
+			}
+			factorial *= level;
+		}
+		return dd[0] * factorial;
+	}
+	
+	/*
+	The polynomial exp splits x into k*ln(2) + r, with |r| <= ln(2)/2, so exp(x) = 2^k * exp(r). exp(r) is found from its
+	Taylor series up to r^13, whose remainder is below the rounding error, and 2^k is built directly from its exponent bits.
+	With MATH_FAST_EXP the series stops at r^9, giving a relative error of under 1e-11.
+	Only valid for |x| < 700, which is always the case once x has been clamped to the limit.
+	*/
+	static const double expLog2e = 1.44269504088896338700e+00;
+	static const double expLn2Hi = 6.93147180369123816490e-01; //ln(2) split so that k * expLn2Hi is exact
+	static const double expLn2Lo = 1.90821492927058770002e-10;
+	static const double expCoefficients[14] = { 1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+		1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800.0 };
+
+#ifdef MATH_FAST_EXP
+	static const int expDegree = 9;
+#else
+	static const int expDegree = 13;
+#endif
+
+	static inline double exp_poly(double x) {
+		const double shifter = 6755399441055744.0; //1.5 * 2^52, adding and subtracting it rounds to the nearest integer
+		double k = (x * expLog2e + shifter) - shifter;
+		double r = (x - k * expLn2Hi) - k * expLn2Lo;
+		double p = expCoefficients[expDegree];
+		for (int i = expDegree - 1; i >= 0; i--) {
+			p = p * r + expCoefficients[i];
+		}
+		int64_t bits = ((int64_t)k + 1023) << 52;
+		double scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		return p * scale;
+	}
+
+	static inline double exp_base(double x) {
+#ifdef MATH_FAST_EXP
+		return exp_poly(x);
+#else
+		return exp(x);
+#endif
+	}
+
+	double exp_safe(double x, double limit) {
+		if (x > limit) {
+			return exp_base(limit)*(x - limit + 1);
+		}
+		else if (x < -limit) {
+			return exp_base(-limit)*(x + limit + 1);
+		}
+		else {
+			return exp_base(x);
+		}
+	}
+
+	double exp_deriv(double x, double limit) {
+		if (x > limit) {
+			return exp_base(limit);
+		}
+		else if (x < -limit) {
+			return exp_base(-limit);
+		}
+		else {
+			return exp_base(x);
+		}
+	}
+
+	void exp_safe_with_deriv(double x, double &e, double &de, double limit) {
+		if (x > limit) {
+			de = exp_base(limit);
+			e = de * (x - limit + 1);
+		}
+		else if (x < -limit) {
+			de = exp_base(-limit);
+			e = de * (x + limit + 1);
+		}
+		else {
+			de = exp_base(x);
+			e = de;
+		}
+	}
+
+	void tanh_with_deriv(double x, double &t, double &dt) {
+		t = tanh(x);
+		dt = 1 - t * t;
+	}
+
+#if defined(__AVX512F__)
+	static inline __m512d exp8(__m512d x) {
+		__m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(expLog2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(expLn2Hi), x);
+		r = _mm512_fnmadd_pd(k, _mm512_set1_pd(expLn2Lo), r);
+		__m512d p = _mm512_set1_pd(expCoefficients[expDegree]);
+		for (int i = expDegree - 1; i >= 0; i--) {
+			p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(expCoefficients[i]));
+		}
+		__m512i exponent = _mm512_cvtepi32_epi64(_mm512_cvtpd_epi32(k));
+		exponent = _mm512_slli_epi64(_mm512_add_epi64(exponent, _mm512_set1_epi64(1023)), 52);
+		return _mm512_mul_pd(p, _mm512_castsi512_pd(exponent));
+	}
+#elif defined(__AVX2__)
+	static inline __m256d exp4(__m256d x) {
+		__m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(expLog2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256d r = _mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(expLn2Hi)));
+		r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(expLn2Lo)));
+		__m256d p = _mm256_set1_pd(expCoefficients[expDegree]);
+		for (int i = expDegree - 1; i >= 0; i--) {
+#ifdef __FMA__
+			p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(expCoefficients[i]));
+#else
+			p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(expCoefficients[i]));
+#endif
+		}
+		__m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+		exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+		return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+	}
+#endif
+
+	void exp_safe_batch(const double *x, double *e, double *de, int n, double limit) {
+		int k = 0;
+		//Beyond the limit exp_safe continues as a straight line, so exp_safe(x) = exp(c) * (1 + x - c) where c is x clamped to the limit
+#if defined(__AVX512F__)
+		for (; k + 8 <= n; k += 8) {
+			__m512d v = _mm512_loadu_pd(x + k);
+			__m512d c = _mm512_min_pd(_mm512_max_pd(v, _mm512_set1_pd(-limit)), _mm512_set1_pd(limit));
+			__m512d ec = exp8(c);
+			_mm512_storeu_pd(de + k, ec);
+			_mm512_storeu_pd(e + k, _mm512_mul_pd(ec, _mm512_add_pd(_mm512_sub_pd(v, c), _mm512_set1_pd(1.0))));
+		}
+#elif defined(__AVX2__)
+		for (; k + 4 <= n; k += 4) {
+			__m256d v = _mm256_loadu_pd(x + k);
+			__m256d c = _mm256_min_pd(_mm256_max_pd(v, _mm256_set1_pd(-limit)), _mm256_set1_pd(limit));
+			__m256d ec = exp4(c);
+			_mm256_storeu_pd(de + k, ec);
+			_mm256_storeu_pd(e + k, _mm256_mul_pd(ec, _mm256_add_pd(_mm256_sub_pd(v, c), _mm256_set1_pd(1.0))));
+		}
+#endif
+		for (; k < n; k++) {
+			exp_safe_with_deriv(x[k], e[k], de[k], limit);
+		}
+	}
 }
\ No newline at end of file
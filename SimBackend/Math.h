@@ -1,65 +1,90 @@
-#pragma once
-#include <cmath>
-#include <exception>
-/*
-Additional helper functions providing various mathematix
-*/
-namespace Math {
-	//Return the x-value at which f(x) is greatest, for x = start .. start + k*inc .. stop
-	template <typename T, typename Func> T argmax(Func f, T start, T stop, T inc) {
-		T max = f(start), maxPoint = start;
-		for (T x = start; x <= stop; x += inc){
-			T y = f(x);
-			if (y > max) {
-				max = y;
-				maxPoint = x;
-			}
-		}
-		return maxPoint;
-	};
-	
-	//Same as argmax, but with different types for x and f(x)
-	template <typename Tx, typename Tfx, typename Func> Tx argmax2(Func f, Tx start, Tx stop, Tx inc) {
-		Tfx max = f(start);
-		Tx maxPoint = start;
-		for (Tx x = start; x <= stop; x += inc){
-			Tfx y = f(x);
-			if (y > max) {
-				max = y;
-				maxPoint = x;
-			}
-		}
-		return maxPoint;
-	};
-
-	/*
-	Perform a Newton-Raphson iteration for a system of n equations and n variables
-
-	x is the n by 1 matrix containing initial x values, and set to the final values at the end
-	
-	There must then be a n rows by n + 1 columns matrix, the first n columns being the jacobian matrix
-	of derivatives and the n+1th column being the value for -fn(x)
-
-	The function returns the greatest magnitude L-R value
-	*/
-
-	void newtonIteration(int n, double *x, double **m);
-
-	/*
-	Using a Gaussian elimination, puts a n by n+1 matrix into 'row echelon form'
-	*/
-	void gaussianElimination(int n, double **m);
-
-	//Thermal voltage at 300K
-	const double vTherm = 25.85e-3;
-
-	const double pi = 3.1415926535897932384626433832795;
-	const double degreesToRadians = pi / 180;
-
-	/*Safer exp function for use in a Newtonian solver - models as linear above a certain point*/
-	double exp_safe(double x, double limit = 45);
-
-	/*Derivative of above function*/
-	double exp_deriv(double x, double limit = 45);
-
+#pragma once
+#include <cmath>
+#include <exception>
+/*
+Additional helper functions providing various mathematix
+*/
+namespace Math {
+	//Return the x-value at which f(x) is greatest, for x = start .. start + k*inc .. stop
+	template <typename T, typename Func> T argmax(Func f, T start, T stop, T inc) {
+		T max = f(start), maxPoint = start;
+		for (T x = start; x <= stop; x += inc){
+			T y = f(x);
+			if (y > max) {
+				max = y;
+				maxPoint = x;
+			}
+		}
+		return maxPoint;
+	};
+	
+	//Same as argmax, but with different types for x and f(x)
+	template <typename Tx, typename Tfx, typename Func> Tx argmax2(Func f, Tx start, Tx stop, Tx inc) {
+		Tfx max = f(start);
+		Tx maxPoint = start;
+		for (Tx x = start; x <= stop; x += inc){
+			Tfx y = f(x);
+			if (y > max) {
+				max = y;
+				maxPoint = x;
+			}
+		}
+		return maxPoint;
+	};
+
+	/*
+	Limit the change in a pn junction voltage in a Newton-Raphson step from vold to vnew, returning the voltage to use
+	(pnjlim in SPICE). Above vcrit the junction current rises so steeply that the linearised step goes much too far,
+	so there the step follows the log of the current instead. vt is the thermal voltage times the ideality factor.
+	*/
+	double pnjlim(double vnew, double vold, double vt, double vcrit);
+
+	//Junction voltage above which pnjlim limits steps, given vt as above and the saturation current
+	double pnjcrit(double vt, double is);
+
+	//Limit the change in a MOSFET gate-source voltage, so that a step does not go far across the threshold voltage vto (fetlim in SPICE)
+	double fetlim(double vnew, double vold, double vto);
+
+	//Limit the change in a MOSFET drain-source voltage (limvds in SPICE)
+	double limvds(double vnew, double vold);
+
+	/*
+	Coefficients of the backward differentiation formula of a given order, for variable timesteps: the derivative at t[0]
+	of the polynomial through the points (t[k], x[k]) for k = 0 to order is the sum of a[k]*x[k]. Times are newest first.
+	*/
+	void bdfCoefficients(const double *t, int order, double *a);
+
+	//Estimate the derivative of a given order (at most 15) from the values x[k] at times t[k], for k = 0 to order, as order! times their divided difference
+	double derivativeEstimate(const double *t, const double *x, int order);
+
+	//Thermal voltage at 300K
+	const double vTherm = 25.85e-3;
+
+	const double pi = 3.1415926535897932384626433832795;
+	const double degreesToRadians = pi / 180;
+
+	/*Safer exp function for use in a Newtonian solver - models as linear above a certain point*/
+	double exp_safe(double x, double limit = 45);
+
+	/*Derivative of above function*/
+	double exp_deriv(double x, double limit = 45);
+
+	/*exp_safe and exp_deriv of the same value, sharing a single exp*/
+	void exp_safe_with_deriv(double x, double &e, double &de, double limit = 45);
+
+	/*
+	exp_safe and exp_deriv of n values at once, for evaluating many devices of the same type together. Built with AVX2
+	or AVX-512 this uses a vector polynomial for exp, which may differ from the library exp in the last bit or two.
+	*/
+	void exp_safe_batch(const double *x, double *e, double *de, int n, double limit = 45);
+
+	/*tanh and its derivative 1 - tanh^2, sharing a single tanh*/
+	void tanh_with_deriv(double x, double &t, double &dt);
+
+	/*
+	If MATH_FAST_EXP is defined, the exp functions above use a shorter polynomial in place of the library exp, with
+	a relative error below 1e-11. This is far tighter than the solver tolerances, but results will no longer match
+	a build without it bit for bit.
+	*/
+
 }
\ No newline at end of file
@@ -1,244 +1,97 @@
-#include "DiscreteSemis.h"
-
-
-std::string NMOS::GetComponentType() {
-	return "NMOS";
-}
-
-int NMOS::GetNumberOfPins() {
-	return 3;
-}
-
-void NMOS::SetParameters(ParameterSet params) {
-	K = params.getDouble("k", K);
-	lambda = params.getDouble("lambda", lambda);
-	Vth = params.getDouble("vth", Vth);
-
-	Rgs = params.getDouble("rgs", Rgs);
-}
-
-
-double NMOS::DCFunction(DCSolver *solver, int f) {
-	double Vgs = solver->GetNetVoltage(PinConnections[1]) - solver->GetNetVoltage(PinConnections[0]);
-	double Vds = solver->GetNetVoltage(PinConnections[2]) - solver->GetNetVoltage(PinConnections[0]);
-	if (f == 0) {
-		double L = 0;
-		if (Vgs < Vth) {
-			L = solver->GetPinCurrent(this, 1);
-		}
-		else {
-			if (/*Vds > 0*/true) {
-				if (Vds < (Vgs - Vth)) {
-					L = K * ((Vgs - Vth) * Vds - (pow(Vds, 2) / 2)) * (1 + lambda * abs(Vds)) + solver->GetPinCurrent(this, 1);
-				}
-				else {
-					L = (K / 2) * pow(Vgs - Vth, 2) * (1 + lambda * abs(Vds)) + solver->GetPinCurrent(this, 1);
-				}
-			}
-			else {
-				L = solver->GetPinCurrent(this, 1);
-			}
-		}
-		double R = -solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else if (f == 1) {
-		double L = solver->GetPinCurrent(this, 1);
-		double R = (1.0 / Rgs) * Vgs;
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double NMOS::TransientFunction(TransientSolver *solver, int f) {
-	double Vgs = solver->GetNetVoltage(PinConnections[1]) - solver->GetNetVoltage(PinConnections[0]);
-	double Vds = solver->GetNetVoltage(PinConnections[2]) - solver->GetNetVoltage(PinConnections[0]);
-
-	if (f == 0) {
-		double L = 0;
-		if (Vgs < Vth) {
-			L = solver->GetPinCurrent(this, 1);
-		}
-		else {
-			if (/*Vds > 0*/true) {
-				if (Vds < (Vgs - Vth)) {
-					L = K * ((Vgs - Vth) * Vds - (pow(Vds, 2) / 2)) * (1 + lambda * abs(Vds)) + solver->GetPinCurrent(this, 1);
-				}
-				else {
-					L = (K / 2) * pow(Vgs - Vth, 2) * (1 + lambda * abs(Vds)) + solver->GetPinCurrent(this, 1);
-				}
-			}
-			else {
-				L = solver->GetPinCurrent(this, 1);
-			}
-		}
-		double R = -solver->GetPinCurrent(this, 0);
-		return L - R;
-	}
-	else if (f == 1) {
-		double L = solver->GetPinCurrent(this, 1);
-		double R = (1.0 / Rgs) * Vgs;
-		return L - R;
-	}
-	else {
-		return 0;
-	}
-}
-
-double NMOS::DCDerivative(DCSolver *solver, int f, VariableIdentifier var) {
-	double Vs = solver->GetNetVoltage(PinConnections[0]);
-	double Vg = solver->GetNetVoltage(PinConnections[1]);
-	double Vd = solver->GetNetVoltage(PinConnections[2]);
-
-	double Vgs = Vg - Vs;
-	double Vds = Vd - Vs;
-
-	double lambda_c = lambda;
-	//To compensate for the absolute term in the equation, lambda must be made negative is Vds < 0
-	if (Vds < 0) {
-		lambda_c = -lambda;
-	}
-
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if ((Vgs > Vth) && (/*Vds > 0*/true)) {
-				if (Vds < (Vgs - Vth)) {
-					if (var.net == PinConnections[0]) {
-						return K * (-Vg + Vs + Vth - lambda_c * Vd * Vg + lambda_c * Vs * Vd + lambda_c * Vd * Vth - lambda_c * Vg * Vd + lambda_c * Vth * Vd + 2 * lambda_c * Vs * Vg
-							- (3.0 / 2.0) * lambda_c * pow(Vs, 2) + lambda_c * Vth * Vd - 2 * lambda_c * Vs * Vth + (1.0 / 2.0) * lambda_c * pow(Vd, 2));
-						 
-					}
-					else if (var.net == PinConnections[1]) {
-						return K * (Vd - Vs + lambda_c * pow(Vd, 2) - lambda_c * Vd * Vs - lambda_c * Vs * Vd + lambda_c * pow(Vs, 2));
-					}
-					else if (var.net == PinConnections[2]) {
-						return K * (Vg - Vth - Vd + 2 * lambda_c * Vg * Vd - 2 * lambda_c * Vth * Vd - lambda_c * Vs * Vg + (1.0 / 2.0) * lambda_c * pow(Vs, 2)
-							+ lambda_c * Vs * Vth - (3.0 / 2.0) * lambda_c * pow(Vd, 2) + lambda_c * Vs * Vth + lambda_c * Vd * Vs);
-					}
-
-					//L = K * ((Vgs - Vth) * Vds - (pow(Vds, 2) / 2)) * (1 + lambda * Vds)
-				}
-				else {
-					//L = (K / 2) * pow(Vgs - Vth, 2) * (1 + lambda * Vds) 
-					if (var.net == PinConnections[0]) {
-						return (K / 2.0) * (2 * Vs - 2 * Vg + 2 * Vth + 2 * lambda_c * Vd * Vs - 2 * lambda_c * Vd * Vg + 2 * lambda_c * Vth - lambda_c * Vg - 3 * lambda_c * pow(Vs, 2)
-							- lambda_c * pow(Vth, 2) - 4 * lambda_c * Vs * Vg - 2 * lambda_c * Vg * Vth - 4 * lambda_c * Vth);
-
-					}
-					else if (var.net == PinConnections[1]) {
-						return (K / 2.0) * (2 * Vg - 2 * Vs - 2 * Vth + 2 * lambda_c * Vd * Vg + 2 * lambda_c * Vs * Vd - 2 * lambda_c * Vd * Vth - lambda_c * Vs
-							- 2 * lambda_c * pow(Vs, 2) - 2 * lambda_c * Vg * Vth);
-					}
-					else if (var.net == PinConnections[2]) {
-						return (K / 2.0) * (lambda_c * pow(Vg, 2) + lambda_c * pow(Vth, 2) - 2 * lambda_c * Vs * Vg - 2 * lambda_c * Vg * Vth);
-					}
-				}
-			}
-
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return 1;
-			}
-			else if ((var.component == this) && (var.pin == 1)) {
-				return 1;
-			}
-		}
-	}
-	else if (f == 1) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return (1.0 / Rgs);
-			}
-			else if (var.net == PinConnections[1]) {
-				return -(1.0 / Rgs);
-			}
-		} 
-		else {
-			if ((var.component == this) && (var.pin == 1)) {
-				return 1;
-			}
-		}
-	}
-	return 0;
-}
-
-double NMOS::TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var) {
-	double Vs = solver->GetNetVoltage(PinConnections[0]);
-	double Vg = solver->GetNetVoltage(PinConnections[1]);
-	double Vd = solver->GetNetVoltage(PinConnections[2]);
-
-	double Vgs = Vg - Vs;
-	double Vds = Vd - Vs;
-
-	double lambda_c = lambda;
-	//To compensate for the absolute term in the equation, lambda must be made negative is Vds < 0
-	if (Vds < 0) {
-		lambda_c = -lambda;
-	}
-
-	if (f == 0) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if ((Vgs > Vth) && (/*Vds > 0*/true)) {
-				if (Vds < (Vgs - Vth)) {
-					if (var.net == PinConnections[0]) {
-						return K * (-Vg + Vs + Vth - lambda_c * Vd * Vg + lambda_c * Vs * Vd + lambda_c * Vd * Vth - lambda_c * Vg * Vd + lambda_c * Vth * Vd + 2 * lambda_c * Vs * Vg
-							- (3.0 / 2.0) * lambda_c * pow(Vs, 2) + lambda_c * Vth * Vd - 2 * lambda_c * Vs * Vth + (1.0 / 2.0) * lambda_c * pow(Vd, 2));
-
-					}
-					else if (var.net == PinConnections[1]) {
-						return K * (Vd - Vs + lambda_c * pow(Vd, 2) - lambda_c * Vd * Vs - lambda_c * Vs * Vd + lambda_c * pow(Vs, 2));
-					}
-					else if (var.net == PinConnections[2]) {
-						return K * (Vg - Vth - Vd + 2 * lambda_c * Vg * Vd - 2 * lambda_c * Vth * Vd - lambda_c * Vs * Vg + (1.0 / 2.0) * lambda_c * pow(Vs, 2)
-							+ lambda_c * Vs * Vth - (3.0 / 2.0) * lambda_c * pow(Vd, 2) + lambda_c * Vs * Vth + lambda_c * Vd * Vs);
-					}
-
-					//L = K * ((Vgs - Vth) * Vds - (pow(Vds, 2) / 2)) * (1 + lambda * Vds)
-				}
-				else {
-					//L = (K / 2) * pow(Vgs - Vth, 2) * (1 + lambda * Vds) 
-					if (var.net == PinConnections[0]) {
-						return (K / 2.0) * (2 * Vs - 2 * Vg + 2 * Vth + 2 * lambda_c * Vd * Vs - 2 * lambda_c * Vd * Vg + 2 * lambda_c * Vth - lambda_c * Vg - 3 * lambda_c * pow(Vs, 2)
-							- lambda_c * pow(Vth, 2) - 4 * lambda_c * Vs * Vg - 2 * lambda_c * Vg * Vth - 4 * lambda_c * Vth);
-
-					}
-					else if (var.net == PinConnections[1]) {
-						return (K / 2.0) * (2 * Vg - 2 * Vs - 2 * Vth + 2 * lambda_c * Vd * Vg + 2 * lambda_c * Vs * Vd - 2 * lambda_c * Vd * Vth - lambda_c * Vs
-							- 2 * lambda_c * pow(Vs, 2) - 2 * lambda_c * Vg * Vth);
-					}
-					else if (var.net == PinConnections[2]) {
-						return (K / 2.0) * (lambda_c * pow(Vg, 2) + lambda_c * pow(Vth, 2) - 2 * lambda_c * Vs * Vg - 2 * lambda_c * Vg * Vth);
-					}
-				}
-			}
-
-		}
-		else {
-			if ((var.component == this) && (var.pin == 0)) {
-				return 1;
-			}
-			else if ((var.component == this) && (var.pin == 1)) {
-				return 1;
-			}
-		}
-	}
-	else if (f == 1) {
-		if (var.type == VariableIdentifier::VariableType::NET) {
-			if (var.net == PinConnections[0]) {
-				return (1.0 / Rgs);
-			}
-			else if (var.net == PinConnections[1]) {
-				return -(1.0 / Rgs);
-			}
-		}
-		else {
-			if ((var.component == this) && (var.pin == 1)) {
-				return 1;
-			}
-		}
-	}
-	return 0;
-}
+#include "DiscreteSemis.h"
+
+
+std::string NMOS::GetComponentType() {
+	return "NMOS";
+}
+
+int NMOS::GetNumberOfPins() {
+	return 3;
+}
+
+bool NMOS::SupportsBypass() {
+	return true;
+}
+
+bool NMOS::SupportsParallelEvaluation() {
+	return true;
+}
+
+void NMOS::SetParameters(ParameterSet params) {
+	K = params.getDouble("k", K);
+	lambda = params.getDouble("lambda", lambda);
+	Vth = params.getDouble("vth", Vth);
+
+	Rgs = params.getDouble("rgs", Rgs);
+}
+
+
+template <typename Solver> void NMOS::Stamp(Solver *solver, double *f, double *dfdI, double *dfdV) {
+	double Vgs = solver->GetNetVoltage(PinConnections[1]) - solver->GetNetVoltage(PinConnections[0]);
+	double Vds = solver->GetNetVoltage(PinConnections[2]) - solver->GetNetVoltage(PinConnections[0]);
+	double Is = solver->GetPinCurrent(this, 0);
+	double Ig = solver->GetPinCurrent(this, 1);
+	//While limited, the drain current is linearised about the limited voltages (see LimitStep)
+	double VgsLin = StepLimited ? LimitedVgs : Vgs;
+	double VdsLin = StepLimited ? LimitedVds : Vds;
+
+	//Drain current and its derivatives with respect to Vgs and Vds
+	double Id = 0, dIdVgs = 0, dIdVds = 0;
+	if (VgsLin >= Vth) {
+		double modulation = 1 + lambda * abs(VdsLin);
+		double dModulation = (VdsLin < 0) ? -lambda : lambda;
+		if (VdsLin < (VgsLin - Vth)) {
+			double A = (VgsLin - Vth) * VdsLin - (pow(VdsLin, 2) / 2);
+			Id = K * A * modulation;
+			dIdVgs = K * VdsLin * modulation;
+			dIdVds = K * ((VgsLin - Vth - VdsLin) * modulation + A * dModulation);
+		}
+		else {
+			Id = (K / 2) * pow(VgsLin - Vth, 2) * modulation;
+			dIdVgs = K * (VgsLin - Vth) * modulation;
+			dIdVds = (K / 2) * pow(VgsLin - Vth, 2) * dModulation;
+		}
+	}
+	if (StepLimited) Id += dIdVgs * (Vgs - VgsLin) + dIdVds * (Vds - VdsLin);
+
+	f[0] = (Id + Ig) + Is;
+	f[1] = Ig - (1.0 / Rgs) * Vgs;
+	if (dfdI == nullptr) return;
+	dfdI[0] = 1;
+	dfdI[1] = 1;
+	dfdV[0] = -dIdVgs - dIdVds;
+	dfdV[1] = dIdVgs;
+	dfdV[2] = dIdVds;
+
+	dfdI[3] = 1;
+	dfdV[3] = 1.0 / Rgs;
+	dfdV[4] = -1.0 / Rgs;
+}
+
+bool NMOS::LimitStep(const double *values, const double *step) {
+	double Vgs = GetPinVoltage(values, 1) - GetPinVoltage(values, 0);
+	double dVgs = GetPinVoltageStep(step, 1) - GetPinVoltageStep(step, 0);
+	double Vds = GetPinVoltage(values, 2) - GetPinVoltage(values, 0);
+	double dVds = GetPinVoltageStep(step, 2) - GetPinVoltageStep(step, 0);
+
+	//The steps are limited from the voltages the model was last linearised about
+	double VgsOld = StepLimited ? LimitedVgs : Vgs;
+	double VdsOld = StepLimited ? LimitedVds : Vds;
+	double VgsNew = Vgs + dVgs, VdsNew = Vds + dVds;
+	LimitedVgs = Math::fetlim(VgsNew, VgsOld, Vth);
+	//limvds expects the drain to be above the source, so with it below Vds is limited as if they were swapped
+	if (VdsOld >= 0)
+		LimitedVds = Math::limvds(VdsNew, VdsOld);
+	else
+		LimitedVds = -Math::limvds(-VdsNew, -VdsOld);
+	StepLimited = (LimitedVgs != VgsNew) || (LimitedVds != VdsNew);
+	return StepLimited;
+}
+
+void NMOS::TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
+
+void NMOS::DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV) {
+	Stamp(solver, f, dfdI, dfdV);
+}
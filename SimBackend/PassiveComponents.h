@@ -1,50 +1,57 @@
-#pragma once
-class Component;
-#include "Component.h"
-/*
-Collection of prototypes for passive components
-Code for these components are in individual cpp files
-*/
-
-/*
-An ideal resistor
-*/
-class Resistor :
-	public Component
-{
-public:
-	std::string GetComponentType();
-	int GetNumberOfPins();
-	double DCFunction(DCSolver *solver, int f);
-	double TransientFunction(TransientSolver *solver, int f);
-	double DCDerivative(DCSolver *solver, int f, VariableIdentifier var);
-	double TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var);
-
-	void SetParameters(ParameterSet params);
-private:
-	double Resistance = 0; //Resistance in ohms
-};
-
-/*
-An capacitor, approximated trapezoidially, with optional series resistances 
-*/
-class Capacitor :
-	public Component
-{
-public:
-	std::string GetComponentType();
-	int GetNumberOfPins();
-	double DCFunction(DCSolver *solver, int f);
-	double TransientFunction(TransientSolver *solver, int f);
-	double DCDerivative(DCSolver *solver, int f, VariableIdentifier var);
-	double TransientDerivative(TransientSolver *solver, int f, VariableIdentifier var);
-
-	void SetParameters(ParameterSet params);
-
-private:
-	double Capacitance = 1e-9;
-	double SeriesResistance = 1e-3;
-	double DCResistance = 1e12; 
-	double lastT = 0;
-	double usingBE = false;
+#pragma once
+class Component;
+#include "Component.h"
+/*
+Collection of prototypes for passive components
+Code for these components are in individual cpp files
+*/
+
+/*
+An ideal resistor
+*/
+class Resistor :
+	public Component
+{
+public:
+	std::string GetComponentType();
+	int GetNumberOfPins();
+	void TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV);
+	void DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV);
+	JacobianDependence GetJacobianDependence();
+	bool IsLinear();
+	bool SupportsParallelEvaluation();
+
+	void SetParameters(ParameterSet params);
+private:
+	template <typename Solver> void Stamp(Solver *solver, double *f, double *dfdI, double *dfdV);
+	double Resistance = 0; //Resistance in ohms
+};
+
+/*
+An capacitor, approximated trapezoidially, with optional series resistances 
+*/
+class Capacitor :
+	public Component
+{
+public:
+	std::string GetComponentType();
+	int GetNumberOfPins();
+	void TransientStamp(TransientSolver *solver, double *f, double *dfdI, double *dfdV);
+	void DCStamp(DCSolver *solver, double *f, double *dfdI, double *dfdV);
+	JacobianDependence GetJacobianDependence();
+	bool IsLinear();
+	bool SupportsParallelEvaluation();
+	double GetTruncationError(TransientSolver *solver);
+
+	void SetParameters(ParameterSet params);
+
+private:
+	template <typename Solver> void Stamp(Solver *solver, double *f, double *dfdI, double *dfdV);
+
+	//Get the voltage across the capacitance, excluding the series resistance, at a given tick
+	template <typename Solver> double GetVoltage(Solver *solver, int tick);
+
+	double Capacitance = 1e-9;
+	double SeriesResistance = 1e-3;
+	double DCResistance = 1e12; 
 };
\ No newline at end of file
@@ -1,122 +1,179 @@
-#include <iostream>
-#include <fstream>
-#include <streambuf>
-#include <thread>
-#include <mutex>
-
-#include "DCSolver.h"
-#include "TransientSolver.h"
-#include "Net.h"
-#include "Component.h"
-#include "PassiveComponents.h"
-#include "DiscreteSemis.h"
-#include "Circuit.h"
-
-Circuit circuit;
-
-std::vector<std::string> lineBuffer;
-std::mutex lineBufferMutex;
-
-void interactiveTick(TransientSolver *solver) {
-	std::cout << "RESULT " << solver->GetTimeAtTick(solver->GetCurrentTick()) << ",";
-	for (int i = 0; i < circuit.Nets.size(); i++) {
-		std::cout << solver->GetNetVoltage(circuit.Nets[i]) << ",";
-	}
-	for (int i = 0; i < circuit.Components.size(); i++) {
-		for (int j = 0; j < circuit.Components[i]->GetNumberOfPins(); j++) {
-			std::cout << solver->GetPinCurrent(circuit.Components[i], j) << ",";
-		}
-	}
-	std::cout << std::endl;
-	lineBufferMutex.lock();
-	for each(std::string line in lineBuffer) {
-		std::stringstream ss(line);
-		
-		std::string part;
-		std::vector<std::string> parts;
-		while (std::getline(ss, part, ' ')) {
-			parts.push_back(part);	
-		}
-		if (parts.size() > 2) {
-			if (parts[0] == "CHANGE") {
-				for each(Component *c in circuit.Components) {
-					if (c->ComponentID == parts[1]) {
-						c->SetParameters(ParameterSet(parts));
-					}
-				}
-			}
-		}
-	}
-	lineBuffer.clear();
-	lineBufferMutex.unlock();
-}
-
-
-
-void iothread() {
-	std::string line;
-	while (true) {
-		std::getline(std::cin, line);
-		if (line == "CONTINUE") {
-			circuit.ContinueFromError = true;
-		}
-		else {
-			lineBufferMutex.lock();
-			lineBuffer.push_back(line);
-			lineBufferMutex.unlock();
-		}
-
-	}
-}
-
-int main(int argc, char* argv[])
-{
-	std::string line = "";
-	std::string netlist = "";
-	char buf[2048];
-	double simSpeed = 0;
-	while (1) {
-		std::cin.getline(buf, 2048);
-		line = std::string(buf);
-		if (line.find("START") != std::string::npos) {
-			simSpeed = atof(line.substr(6).c_str());
-			break;
-		}
-		netlist.append(line);
-		netlist.append("\n");
-	}
-
-	circuit.ReadNetlist(netlist);
-	std::cout << "VARS t,";
-
-	for (int i = 0; i < circuit.Nets.size(); i++) {
-		std::cout << "V(" << circuit.Nets[i]->NetName << "),";
-	}
-	for (int i = 0; i < circuit.Components.size(); i++) {
-		for (int j = 0; j < circuit.Components[i]->GetNumberOfPins(); j++) {
-			std::cout << "I(" << circuit.Components[i]->ComponentID << "." << j << "),";
-		}
-	}
-	std::cout << std::endl;
-
-	DCSolver solver(&circuit);
-	bool result = false;
-	try {
-		result = solver.Solve();
-	}
-	catch (void *e){
-		std::cerr << "Failed to obtain initial operating point" << std::endl;
-		circuit.ReportError("EXCEPTION", true);
-	}
-	if (!result) {
-		circuit.ReportError("CONVERGENCE", false);
-	}
-
-
-	TransientSolver tranSolver(solver);
-	tranSolver.InteractiveCallback = interactiveTick;
-	std::thread updaterThread(iothread);
-	tranSolver.RunInteractive(simSpeed);
-	return 0;
-}
-
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include "DCSolver.h"
+#include "TransientSolver.h"
+#include "Net.h"
+#include "Component.h"
+#include "PassiveComponents.h"
+#include "DiscreteSemis.h"
+#include "Circuit.h"
+#include "AllocationCheck.h"
+
+Circuit circuit;
+
+std::vector<std::string> lineBuffer;
+std::mutex lineBufferMutex;
+
+void printResult(TransientSolver *solver) {
+	std::cout << "RESULT " << solver->GetTimeAtTick(solver->GetCurrentTick()) << ",";
+	for (int i = 0; i < circuit.Nets.size(); i++) {
+		std::cout << solver->GetNetVoltage(circuit.Nets[i]) << ",";
+	}
+	for (int i = 0; i < circuit.Components.size(); i++) {
+		for (int j = 0; j < circuit.Components[i]->GetNumberOfPins(); j++) {
+			std::cout << solver->GetPinCurrent(circuit.Components[i], j) << ",";
+		}
+	}
+}
+
+//Results are written as they are found, but only flushed at the end of a batch simulation
+void batchTick(TransientSolver *solver) {
+	printResult(solver);
+	std::cout << "\n";
+}
+
+void interactiveTick(TransientSolver *solver) {
+	printResult(solver);
+	std::cout << std::endl;
+	lineBufferMutex.lock();
+	for (std::string line : lineBuffer) {
+		std::stringstream ss(line);
+		
+		std::string part;
+		std::vector<std::string> parts;
+		while (std::getline(ss, part, ' ')) {
+			parts.push_back(part);	
+		}
+		if (parts.size() > 2) {
+			if (parts[0] == "CHANGE") {
+				for (Component *c : circuit.Components) {
+					if (c->ComponentID == parts[1]) {
+						c->SetParameters(ParameterSet(parts));
+					}
+				}
+				solver->ParametersChanged();
+			}
+		}
+	}
+	lineBuffer.clear();
+	lineBufferMutex.unlock();
+}
+
+
+
+void iothread() {
+#ifdef ALLOCATION_CHECK
+	AllocationCheck::IgnoreThisThread();
+#endif
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		if (line == "CONTINUE") {
+			circuit.ContinueFromError = true;
+		}
+		else {
+			lineBufferMutex.lock();
+			lineBuffer.push_back(line);
+			lineBufferMutex.unlock();
+		}
+
+	}
+}
+
+/*
+The netlist is read from stdin up to a line starting the simulation, which is either
+
+	START speed
+		to run interactively at speed times real time until killed, taking CHANGE and CONTINUE commands from stdin
+	TRAN tstop tstep [tmax]
+		to run in batch mode from 0 to tstop as fast as possible, with results every tstep and a timestep of at most
+		tmax (tstep by default), then exit. Errors are reported but not waited on. The last line written is
+			DONE ticks,rejected ticks,Newton-Raphson iterations,wall time in seconds
+		and the exit code is non-zero if the simulation was stopped by an error.
+*/
+int main(int argc, char* argv[])
+{
+	std::string line = "";
+	std::string netlist = "";
+	char buf[2048];
+	double simSpeed = 0;
+	bool batch = false;
+	double stopTime = 0, outputStep = 0, maximumTimestep = 0;
+	while (1) {
+		std::cin.getline(buf, 2048);
+		if (!std::cin) {
+			std::cerr << "Input ended before START or TRAN" << std::endl;
+			return 1;
+		}
+		line = std::string(buf);
+		if (line.compare(0, 5, "TRAN ") == 0) {
+			std::stringstream ss(line.substr(5));
+			ss >> stopTime >> outputStep;
+			if (!(ss >> maximumTimestep))
+				maximumTimestep = outputStep;
+			if (!((stopTime > 0) && (outputStep > 0) && (maximumTimestep > 0))) {
+				std::cerr << "TRAN needs a positive stop time, output step and maximum timestep" << std::endl;
+				return 1;
+			}
+			batch = true;
+			circuit.Unattended = true;
+			break;
+		}
+		if (line.find("START") != std::string::npos) {
+			simSpeed = atof(line.substr(6).c_str());
+			break;
+		}
+		netlist.append(line);
+		netlist.append("\n");
+	}
+
+	circuit.ReadNetlist(netlist);
+	std::cout << "VARS t,";
+
+	for (int i = 0; i < circuit.Nets.size(); i++) {
+		std::cout << "V(" << circuit.Nets[i]->NetName << "),";
+	}
+	for (int i = 0; i < circuit.Components.size(); i++) {
+		for (int j = 0; j < circuit.Components[i]->GetNumberOfPins(); j++) {
+			std::cout << "I(" << circuit.Components[i]->ComponentID << "." << j << "),";
+		}
+	}
+	std::cout << std::endl;
+
+	DCSolver solver(&circuit);
+	bool result = false;
+	try {
+		result = solver.Solve();
+	}
+	catch (void *e){
+		std::cerr << "Failed to obtain initial operating point" << std::endl;
+		circuit.ReportError("EXCEPTION", true);
+		return 1;
+	}
+	if (!result) {
+		circuit.ReportError("CONVERGENCE", false);
+	}
+
+
+	TransientSolver tranSolver(solver);
+	if (batch) {
+		tranSolver.InteractiveCallback = batchTick;
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		bool completed = tranSolver.RunBatch(stopTime, outputStep, maximumTimestep);
+		double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		std::cout << "DONE " << tranSolver.AcceptedTicks << "," << tranSolver.RejectedTicks << "," << tranSolver.NewtonIterations
+			<< "," << wallTime << std::endl;
+		tranSolver.PrintNewtonStatistics();
+		return completed ? 0 : 1;
+	}
+	tranSolver.InteractiveCallback = interactiveTick;
+	std::thread updaterThread(iothread);
+	tranSolver.RunInteractive(simSpeed);
+	return 0;
+}
+
@@ -0,0 +1,272 @@
+#include "SparseLU.h"
+#include <cmath>
+#include <stdexcept>
+#include <set>
+
+SparseLU::SparseLU() {
+
+}
+
+void SparseLU::Factorise(const SparseMatrix &m) {
+	if (Analysed && (m.GetSize() == Size) && (m.GetNonZeroCount() == AnalysedNonZeros)) {
+		if (Refactorise(m)) return;
+	}
+	FactoriseWithPivoting(m);
+}
+
+void SparseLU::FactoriseWithPivoting(const SparseMatrix &m) {
+	int n = m.GetSize();
+	Resize(n);
+	Analysed = false;
+	LRowIndex.clear();
+	LValues.clear();
+	URowIndex.clear();
+	UValues.clear();
+	for (int i = 0; i < n; i++) PivotOfRow[i] = -1;
+
+	for (int k = 0; k < n; k++) {
+		int col = ColumnOrder.empty() ? k : ColumnOrder[k];
+		LColumnStart[k] = LRowIndex.size();
+		UColumnStart[k] = URowIndex.size();
+
+		//Sparse triangular solve: Work = L \ A(:,col)
+		int top = Reach(m, col);
+		for (int p = top; p < n; p++) Work[Pattern[p]] = 0;
+		for (int p = m.ColumnStart[col]; p < m.ColumnStart[col + 1]; p++) Work[m.RowIndex[p]] = m.Values[p];
+		for (int px = top; px < n; px++) {
+			int j = Pattern[px];
+			int J = PivotOfRow[j];
+			if (J < 0) continue;
+			//The first entry in each column of L is the unit diagonal, so is skipped
+			for (int p = LColumnStart[J] + 1; p < LColumnStart[J + 1]; p++) {
+				Work[LRowIndex[p]] -= LValues[p] * Work[j];
+			}
+		}
+
+		//Rows that already have a pivot form U(:,k), the largest of the remaining rows is the new pivot
+		int pivotRow = -1;
+		double largest = 0;
+		for (int p = top; p < n; p++) {
+			int i = Pattern[p];
+			if (PivotOfRow[i] < 0) {
+				if (std::abs(Work[i]) > largest) {
+					largest = std::abs(Work[i]);
+					pivotRow = i;
+				}
+			}
+			else {
+				URowIndex.push_back(PivotOfRow[i]);
+				UValues.push_back(Work[i]);
+			}
+		}
+		if (pivotRow == -1)
+			throw new std::runtime_error("Matrix is singular");
+
+		double pivot = Work[pivotRow];
+		URowIndex.push_back(k);
+		UValues.push_back(pivot);
+		PivotOfRow[pivotRow] = k;
+
+		LRowIndex.push_back(pivotRow);
+		LValues.push_back(1);
+		for (int p = top; p < n; p++) {
+			int i = Pattern[p];
+			if (PivotOfRow[i] < 0) {
+				LRowIndex.push_back(i);
+				LValues.push_back(Work[i] / pivot);
+			}
+			Work[i] = 0;
+		}
+	}
+	LColumnStart[n] = LRowIndex.size();
+	UColumnStart[n] = URowIndex.size();
+
+	//Renumber the rows of L into pivot order
+	for (size_t p = 0; p < LRowIndex.size(); p++) {
+		LRowIndex[p] = PivotOfRow[LRowIndex[p]];
+	}
+
+	Analysed = true;
+	AnalysedNonZeros = m.GetNonZeroCount();
+	PivotingFactorisations++;
+}
+
+bool SparseLU::Refactorise(const SparseMatrix &m) {
+	int n = Size;
+	for (int k = 0; k < n; k++) {
+		int col = ColumnOrder.empty() ? k : ColumnOrder[k];
+
+		//Work holds the column in pivot order. Its pattern is that of U(:,k) and L(:,k), which cover A(:,col)
+		for (int p = UColumnStart[k]; p < UColumnStart[k + 1]; p++) Work[URowIndex[p]] = 0;
+		for (int p = LColumnStart[k]; p < LColumnStart[k + 1]; p++) Work[LRowIndex[p]] = 0;
+		for (int p = m.ColumnStart[col]; p < m.ColumnStart[col + 1]; p++) Work[PivotOfRow[m.RowIndex[p]]] = m.Values[p];
+
+		for (int px = UColumnStart[k]; px < UColumnStart[k + 1] - 1; px++) {
+			int J = URowIndex[px];
+			double x = Work[J];
+			UValues[px] = x;
+			for (int p = LColumnStart[J] + 1; p < LColumnStart[J + 1]; p++) {
+				Work[LRowIndex[p]] -= LValues[p] * x;
+			}
+		}
+
+		double pivot = Work[k];
+		double largest = std::abs(pivot);
+		for (int p = LColumnStart[k] + 1; p < LColumnStart[k + 1]; p++) {
+			largest = fmax(largest, std::abs(Work[LRowIndex[p]]));
+		}
+		if ((pivot == 0) || (std::abs(pivot) < PivotThreshold * largest)) {
+			for (int i = 0; i < n; i++) Work[i] = 0;
+			Analysed = false;
+			return false;
+		}
+
+		UValues[UColumnStart[k + 1] - 1] = pivot;
+		for (int p = LColumnStart[k] + 1; p < LColumnStart[k + 1]; p++) {
+			LValues[p] = Work[LRowIndex[p]] / pivot;
+		}
+	}
+	for (int i = 0; i < n; i++) Work[i] = 0;
+	Refactorisations++;
+	return true;
+}
+
+void SparseLU::Solve(double *b) {
+	int n = Size;
+	//Apply the row permutation
+	for (int i = 0; i < n; i++) Work[PivotOfRow[i]] = b[i];
+	//Forward substitution with L
+	for (int j = 0; j < n; j++) {
+		double x = Work[j];
+		for (int p = LColumnStart[j] + 1; p < LColumnStart[j + 1]; p++) {
+			Work[LRowIndex[p]] -= LValues[p] * x;
+		}
+	}
+	//Back substitution with U
+	for (int j = n - 1; j >= 0; j--) {
+		Work[j] /= UValues[UColumnStart[j + 1] - 1];
+		double x = Work[j];
+		for (int p = UColumnStart[j]; p < UColumnStart[j + 1] - 1; p++) {
+			Work[URowIndex[p]] -= UValues[p] * x;
+		}
+	}
+	//Undo the column ordering
+	for (int k = 0; k < n; k++) {
+		b[ColumnOrder.empty() ? k : ColumnOrder[k]] = Work[k];
+		Work[k] = 0;
+	}
+}
+
+void SparseLU::Reset() {
+	Analysed = false;
+}
+
+void SparseLU::SetColumnOrder(const std::vector<int> &order) {
+	ColumnOrder = order;
+	Analysed = false;
+}
+
+void SparseLU::OrderColumns(const SparseMatrix &m) {
+	int n = m.GetSize();
+	//Build the column adjacency graph: two columns are adjacent if they have an entry in the same row
+	std::vector<std::vector<int>> rowEntries(n);
+	for (int c = 0; c < n; c++) {
+		for (int p = m.ColumnStart[c]; p < m.ColumnStart[c + 1]; p++) {
+			rowEntries[m.RowIndex[p]].push_back(c);
+		}
+	}
+	std::vector<std::set<int>> adjacent(n);
+	for (int r = 0; r < n; r++) {
+		for (auto a = rowEntries[r].begin(); a != rowEntries[r].end(); ++a) {
+			for (auto b = rowEntries[r].begin(); b != rowEntries[r].end(); ++b) {
+				if (*a != *b) adjacent[*a].insert(*b);
+			}
+		}
+	}
+
+	//Repeatedly eliminate the column with the fewest neighbours, which then become a clique
+	std::vector<int> order;
+	std::vector<char> eliminated(n, 0);
+	for (int k = 0; k < n; k++) {
+		int best = -1;
+		for (int c = 0; c < n; c++) {
+			if (!eliminated[c] && ((best == -1) || (adjacent[c].size() < adjacent[best].size())))
+				best = c;
+		}
+		order.push_back(best);
+		eliminated[best] = 1;
+		std::vector<int> neighbours(adjacent[best].begin(), adjacent[best].end());
+		for (auto a = neighbours.begin(); a != neighbours.end(); ++a) {
+			adjacent[*a].erase(best);
+			for (auto b = neighbours.begin(); b != neighbours.end(); ++b) {
+				if (*a != *b) adjacent[*a].insert(*b);
+			}
+		}
+		adjacent[best].clear();
+	}
+	SetColumnOrder(order);
+}
+
+int SparseLU::GetFactorNonZeroCount() const {
+	return LRowIndex.size() + URowIndex.size();
+}
+
+int SparseLU::GetSize() const {
+	return Size;
+}
+
+void SparseLU::Resize(int n) {
+	if (n != Size) {
+		Size = n;
+		Work.assign(n, 0);
+		Pattern.assign(2 * n, 0);
+		Marked.assign(n, 0);
+		LColumnStart.resize(n + 1);
+		UColumnStart.resize(n + 1);
+		PivotOfRow.resize(n);
+	}
+}
+
+int SparseLU::Reach(const SparseMatrix &m, int col) {
+	int top = Size;
+	for (int p = m.ColumnStart[col]; p < m.ColumnStart[col + 1]; p++) {
+		if (!Marked[m.RowIndex[p]])
+			top = DepthFirstSearch(m.RowIndex[p], top);
+	}
+	for (int p = top; p < Size; p++) Marked[Pattern[p]] = 0;
+	return top;
+}
+
+//Non-recursive depth first search through the graph of L starting at row j
+//Rows are pushed onto the top of Pattern in reverse topological order once all their dependents are visited
+int SparseLU::DepthFirstSearch(int j, int top) {
+	//The DFS stack grows up from the start of Pattern while the result grows down from top, so they never overlap
+	int *stack = &(Pattern[0]);
+	int *next = &(Pattern[Size]);
+	int head = 0;
+	stack[0] = j;
+	while (head >= 0) {
+		j = stack[head];
+		int J = PivotOfRow[j];
+		if (!Marked[j]) {
+			Marked[j] = 1;
+			//Skip the unit diagonal, which is always the first entry
+			next[head] = (J < 0) ? 0 : LColumnStart[J] + 1;
+		}
+		bool done = true;
+		int end = (J < 0) ? 0 : LColumnStart[J + 1];
+		for (int p = next[head]; p < end; p++) {
+			int i = LRowIndex[p];
+			if (Marked[i]) continue;
+			next[head] = p;
+			stack[++head] = i;
+			done = false;
+			break;
+		}
+		if (done) {
+			head--;
+			Pattern[--top] = j;
+		}
+	}
+	return top;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include "SparseMatrix.h"
+/*
+Sparse LU factorisation with partial pivoting, for solving the Newton-Raphson update equations
+using the sparse Jacobian built by the solvers.
+
+This is a left-looking (Gilbert-Peierls) factorisation: each column of L and U is found by a sparse
+triangular solve against the columns already factorised, so the work done is proportional to the number of
+floating point operations rather than the size of the matrix.
+
+The factorisation is PAQ = LU, where L has a unit diagonal, P is the row permutation chosen by pivoting
+and Q is the order columns are eliminated in.
+
+The first factorisation of a matrix finds the pivot sequence and the nonzero pattern of L and U. As the
+circuit topology is fixed during a simulation, later factorisations of a matrix with the same pattern reuse
+these and only recompute the values. If a reused pivot has become too small compared to the other
+candidates in its column, the matrix is factorised again with a fresh pivot search.
+*/
+class SparseLU
+{
+public:
+	SparseLU();
+
+	/*
+	Factorise a matrix, reusing the pivot sequence and pattern of the last full factorisation where possible
+	Throws a runtime_error if the matrix is singular
+	*/
+	void Factorise(const SparseMatrix &m);
+
+	//Factorise a matrix with a full pivot search. Throws a runtime_error if the matrix is singular
+	void FactoriseWithPivoting(const SparseMatrix &m);
+
+	/*
+	Recompute the factorisation using the pivot sequence and pattern of the last full factorisation
+	Returns false if a pivot fails the threshold check, in which case the factorisation is not usable
+	*/
+	bool Refactorise(const SparseMatrix &m);
+
+	//Solve Ax = b using the last factorisation, overwriting b with x
+	void Solve(double *b);
+
+	//Discard the pivot sequence and pattern, so the next factorisation does a full pivot search
+	void Reset();
+
+	//Set the order columns are eliminated in, order[k] being the column eliminated at step k. An empty order means the natural order
+	void SetColumnOrder(const std::vector<int> &order);
+
+	/*
+	Choose a fill-reducing column order for matrices with the pattern of m, and use it for later factorisations
+
+	This is a minimum degree ordering of the graph where two columns are adjacent if they share a row (the pattern of
+	A'A). The fill of this graph is an upper bound on the fill of L and U for any choice of row pivots, so the order stays
+	good however the pivots end up being chosen.
+	*/
+	void OrderColumns(const SparseMatrix &m);
+
+	//Get the number of entries in L and U, a measure of the work needed to factorise and solve
+	int GetFactorNonZeroCount() const;
+
+	//Get the number of rows (and columns) of the factorised matrix
+	int GetSize() const;
+
+	//A reused pivot must be at least this fraction of the largest candidate in its column
+	double PivotThreshold = 1e-3;
+
+	//Number of factorisations done with and without a pivot search
+	int PivotingFactorisations = 0;
+	int Refactorisations = 0;
+
+private:
+	int Size = 0;
+	bool Analysed = false;
+	int AnalysedNonZeros = 0; //Number of entries in the pattern of the matrix the analysis was done for
+
+	/*
+	L and U in compressed column form, with rows numbered in pivot order. The unit diagonal of L is
+	stored first in each column, the diagonal of U last. The off-diagonal entries in each column of U
+	are in the topological order they have to be eliminated in.
+	*/
+	std::vector<int> LColumnStart, LRowIndex, UColumnStart, URowIndex;
+	std::vector<double> LValues, UValues;
+
+	std::vector<int> PivotOfRow; //For each row of A, the column it was chosen as pivot for, or -1 if not yet chosen
+	std::vector<int> ColumnOrder; //Column of A eliminated at each step, or empty for the natural order
+
+	//Workspaces
+	std::vector<double> Work;
+	std::vector<int> Pattern; //2n: nonzero pattern of a column in topological order (sharing space with the DFS stack), then DFS positions
+	std::vector<char> Marked;
+
+	void Resize(int n);
+
+	//Find the nonzero pattern of L \ A(:,col), returning the index in Pattern of its first entry
+	int Reach(const SparseMatrix &m, int col);
+	int DepthFirstSearch(int j, int top);
+};
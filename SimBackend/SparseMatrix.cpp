@@ -0,0 +1,59 @@
+#include "SparseMatrix.h"
+#include <algorithm>
+
+SparseMatrix::SparseMatrix() {
+
+}
+
+void SparseMatrix::Begin(int n) {
+	Size = n;
+	ColumnStart.clear();
+	RowIndex.clear();
+	Values.clear();
+	PendingEntries.clear();
+	PendingEntries.resize(n);
+}
+
+void SparseMatrix::AddEntry(int row, int col) {
+	PendingEntries[col].push_back(row);
+}
+
+void SparseMatrix::Finalise() {
+	ColumnStart.resize(Size + 1);
+	RowIndex.clear();
+	for (int c = 0; c < Size; c++) {
+		std::vector<int> &rows = PendingEntries[c];
+		std::sort(rows.begin(), rows.end());
+		rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+		ColumnStart[c] = RowIndex.size();
+		RowIndex.insert(RowIndex.end(), rows.begin(), rows.end());
+	}
+	ColumnStart[Size] = RowIndex.size();
+	Values.assign(RowIndex.size(), 0);
+	PendingEntries.clear();
+}
+
+int SparseMatrix::GetSlot(int row, int col) const {
+	auto begin = RowIndex.begin() + ColumnStart[col];
+	auto end = RowIndex.begin() + ColumnStart[col + 1];
+	auto pos = std::lower_bound(begin, end, row);
+	if ((pos != end) && (*pos == row)) {
+		return pos - RowIndex.begin();
+	}
+	else {
+		return -1;
+	}
+}
+
+void SparseMatrix::Zero() {
+	std::fill(Values.begin(), Values.end(), 0.0);
+}
+
+int SparseMatrix::GetSize() const {
+	return Size;
+}
+
+int SparseMatrix::GetNonZeroCount() const {
+	return RowIndex.size();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+/*
+A square sparse matrix stored in compressed sparse column (CSC) form
+
+The sparsity pattern is fixed once it has been built: entries that may be non-zero are declared using
+AddEntry, then Finalise is called to build the compressed arrays. After this only the values can change,
+so a solver can look up the slot for each entry once and fill the matrix in place on every iteration.
+*/
+class SparseMatrix
+{
+public:
+	SparseMatrix();
+
+	//Clear the matrix and start building a new pattern for an n by n matrix
+	void Begin(int n);
+
+	//Declare that the entry at (row, col) may be non-zero. Duplicate entries are ignored
+	void AddEntry(int row, int col);
+
+	//Build the compressed arrays from the declared entries, setting all values to zero
+	void Finalise();
+
+	//Get the index into Values for the entry at (row, col), or -1 if it is not part of the pattern
+	int GetSlot(int row, int col) const;
+
+	//Set all values to zero, without changing the pattern
+	void Zero();
+
+	//Get the number of rows (and columns)
+	int GetSize() const;
+
+	//Get the number of entries in the pattern
+	int GetNonZeroCount() const;
+
+	//Column c has its entries stored in slots ColumnStart[c] to ColumnStart[c + 1] - 1, sorted by row
+	std::vector<int> ColumnStart;
+	std::vector<int> RowIndex;
+	std::vector<double> Values;
+
+private:
+	int Size = 0;
+	std::vector<std::vector<int>> PendingEntries; //Row indices declared for each column before Finalise
+};
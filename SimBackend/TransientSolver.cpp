@@ -1,342 +1,1308 @@
-#include "TransientSolver.h"
-#include <Windows.h>
-TransientSolver::TransientSolver()
-{
-	VariableValues.push_back(std::vector<double>());
-	times.push_back(0);
-}
-
-TransientSolver::TransientSolver(DCSolver init)
-{
-	NetVariables = init.NetVariables;
-	ComponentVariables = init.ComponentVariables;
-	VariableData = init.VariableData;
-	VariableValues.push_back(init.VariableValues); 
-	SolverCircuit = init.SolverCircuit;
-	times.push_back(0);
-}
-
-
-void TransientSolver::AddComponent(Component *c) {
-	//Due to Kirchoff's Laws, for a component with n pins we only need n-1 equations
-
-	ComponentVariables[c] = nextFreeVariable;
-	nextFreeVariable += c->GetNumberOfPins() - 1;
-
-	for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
-		VariableValues[0].push_back(0);
-		VariableIdentifier id;
-		id.type = VariableIdentifier::VariableType::COMPONENT;
-		id.component = c;
-		id.pin = i;
-		VariableData[ComponentVariables[c] + i] = id;
-	}
-}
-
-void TransientSolver::AddNet(Net *net) {
-	NetVariables[net] = nextFreeVariable;
-	VariableValues[0].push_back(0);
-	VariableIdentifier id;
-	id.type = VariableIdentifier::VariableType::NET;
-	id.net = net;
-	VariableData[nextFreeVariable] = id;
-	nextFreeVariable++;
-}
-
-double TransientSolver::GetNetVoltage(Net *net, int n) {
-	if (n == -1) n = currentTick;
-	if (net->IsFixedVoltage) {
-		return net->NetVoltage;
-	}
-	else {
-		return VariableValues[n][NetVariables[net]];
-	}
-}
-
-double TransientSolver::GetVarValue(int id, int tick) {
-	if (tick == -1) tick = currentTick;
-	return VariableValues[tick][id];
-	
-}
-
-double TransientSolver::GetPinCurrent(Component *c, int pin, int n) {
-	if (n == -1) n = currentTick;
-	if (pin < c->GetNumberOfPins() - 1) {
-		NetConnection conn;
-		conn.component = c;
-		conn.pin = pin;
-		return VariableValues[n][ComponentVariables[c] + pin];
-	}
-	else {
-		double sum = 0;
-		for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
-			sum += GetPinCurrent(c, i, n);
-		}
-		return -sum;
-	}
-}
-
-int TransientSolver::GetCurrentTick() {
-	return currentTick;
-}
-
-double TransientSolver::GetTimeAtTick(int n) {
-	return times[n];
-}
-
-//This function is very similar to the function used to solve for a DC operating point.
-//See report section 2.4.1
-int TransientSolver::Tick(double tol, int maxIter, bool * convergenceFailureFlag) {
-	clock_t startTime = clock();
-	int n = VariableValues[currentTick].size();
-	double **matrix = new double*[n];
-	double worstTol = 0;
-	int i;
-	for (i = 0; i < n; i++) matrix[i] = new double[n+1];
-	int worstVar = -1;
-	bool convergenceFailure = false;
-
-	for (i = 0; i < maxIter; i++) {
-		
-		for (int j = 0; j < n; j++) {
-			for (int k = 0; k < n+1; k++) {
-				matrix[j][k] = 0;
-			}
-		}
-		//See report section 2.4.1.3
-		for (int j = 0; j < n; j++) {
-			VariableIdentifier varData = VariableData[j];
-			if (varData.type == VariableIdentifier::VariableType::COMPONENT) {
-				matrix[j][n] = -varData.component->TransientFunction(this, varData.pin);
-
-				
-				int k = ComponentVariables[varData.component];
-				int npin = varData.component->GetNumberOfPins();
-				for (int pin = 0; pin < npin; pin++) {
-					//Components only have n-1 variables, but we must run the for loop up to n to check the net connection to the nth pin
-					if (pin < (npin-1))
-						matrix[j][k] = varData.component->TransientDerivative(this, varData.pin, VariableData[k]);
-					Net *pinNet = varData.component->PinConnections[pin];
-					if (!pinNet->IsFixedVoltage) {
-						int netVar = NetVariables[pinNet];
-						matrix[j][netVar] = varData.component->TransientDerivative(this, varData.pin, VariableData[netVar]);
-					}
-					k++;
-				}
-				
-
-			}
-			else {
-				matrix[j][n] = -varData.net->TransientFunction(this);
-
-				int ncon = varData.net->connections.size(); 
-				for (int k = 0; k < ncon; k++) {
-					NetConnection conn = varData.net->connections[k]; 
-					if (conn.pin < (conn.component->GetNumberOfPins() - 1)) {
-						int var = ComponentVariables[conn.component] + conn.pin;
-						matrix[j][var] = varData.net->TransientDerivative(this, VariableData[var]);
-					}
-					else {
-						int npin = conn.component->GetNumberOfPins();
-						for (int l = 0; l < (npin - 1); l++) {
-							int var = ComponentVariables[conn.component] + l;
-							matrix[j][var] = varData.net->TransientDerivative(this, VariableData[var]);
-						}
-					}
-				}
-			}
-		}
-		worstTol = 0;
-	    worstVar = -1;
-		for (int i = 0; i < n; i++) {
-			if (abs(matrix[i][n]) > worstTol) {
-				worstTol = abs(matrix[i][n]);
-				worstVar = i;
-			}
-		}
-		if (worstTol < tol) break;
-		Math::newtonIteration(n, &(VariableValues[currentTick][0]), matrix);
-		if (((clock() - startTime) / ((double)CLOCKS_PER_SEC)) > maxTickTime) {
-			std::cerr << "Tick timeout t=" << GetTimeAtTick(GetCurrentTick()) << " e=" << worstTol << std::endl;
-		
-			convergenceFailure = true;
-			break;
-		}
-	}
-	for (int j = 0; j < n; j++) delete[] matrix[j];
-	delete[] matrix;
-	if (i == maxIter) {
-		std::cerr << "Interactive convergence failure t=" << GetTimeAtTick(GetCurrentTick()) << " e=" << worstTol << " var=" << worstVar << std::endl;
-		convergenceFailure = true;
-	}
-	if (convergenceFailure) {
-		//Only concerned by convergence failures where e>1
-		if (worstTol > 1) {
-			if (convergenceFailureFlag != nullptr)
-				*convergenceFailureFlag = true;
-		}
-	}
-
-	return i;
-}
-
-
-void TransientSolver::RunInteractive(double simSpeed, double tol, int maxIter) {
-
-	double currentTime = 0;
-	//In order to see timestep recommendations and initialise stateful components, run a timestep at 0s - but discard it, as the steady state represents the initial conditions
-	bool firstRun = true;
-	bool running = true;
-	int ticktimestoAvg = 1200;
-	std::deque<double> ticktimes;
-	std::clock_t lastUpdateTime = 0;
-	while (running) {
-		currentTick++;
-		nextTimestep = simSpeed / 10;
-		if (!firstRun) {
-			nextTimestep = simSpeed * averageTickTime;
-		}
-		VariableValues.push_back(VariableValues[currentTick - 1]);
-		times.push_back(currentTime);
-
-		if (VariableValues.size() > bufferSize) {
-			VariableValues.pop_front();
-			times.pop_front();
-			currentTick--;
-		}
-
-		LARGE_INTEGER startT, endT, elapseduS;
-		LARGE_INTEGER freq;
-
-		QueryPerformanceFrequency(&freq);
-		QueryPerformanceCounter(&startT);
-
-		bool convergenceFailure = false;
-		if (firstRun) {
-			try {
-				Tick(tol, maxIter);
-			}
-			catch (std::runtime_error *e) {
-
-			}
-		}
-		else {
-			try {
-				Tick(tol, maxIter, &convergenceFailure);
-			}
-			catch (std::runtime_error *e) {
-				std::cerr << "RUNTIME ERROR AT T=" << currentTime << " : " << e->what() << std::endl;
-				SolverCircuit->ReportError("EXCEPTION", true);
-				running = false;
-			}
-		}
-		
-
-		if (!firstRun) {
-			if (((clock() - lastUpdateTime) / ((double)CLOCKS_PER_SEC)) > 2e-3) {
-				if (InteractiveCallback != nullptr) {
-					(*InteractiveCallback)(this);
-				}
-				lastUpdateTime = clock(); 
-			}
-		}
-
-		QueryPerformanceCounter(&endT);
-		while (((endT.QuadPart - startT.QuadPart) / ((double)freq.QuadPart)) < 1e-4) QueryPerformanceCounter(&endT);
-		//std::cerr << ((endT.QuadPart - startT.QuadPart) / ((double)freq.QuadPart)) << std::endl;
-		elapseduS.QuadPart = endT.QuadPart - startT.QuadPart;
-		elapseduS.QuadPart *= 1000000;
-		elapseduS.QuadPart /= freq.QuadPart;
-
-		//Recalculate tick time 
-		double timeForTick = elapseduS.QuadPart / 1000000.0;
-		ticktimes.push_back(timeForTick);
-		if (ticktimes.size() > ticktimestoAvg) {
-			ticktimes.pop_front();
-		}
-		double ttsum = 0;
-		for (auto iter = ticktimes.begin(); iter != ticktimes.end(); iter++)
-			ttsum += *iter;
-		averageTickTime = ttsum / ticktimes.size();
-
-		totalNumberOfTicks++;
-		if ((totalNumberOfTicks % 30) == 0) {
-			std::cerr << averageTickTime << std::endl;
-		}
-		currentTime += nextTimestep;
-		if (convergenceFailure)
-			SolverCircuit->ReportError("CONVERGENCE", false);
-
-		if (firstRun) {
-			VariableValues.erase(VariableValues.end() - 1);
-			times.erase(times.end() - 1);
-			currentTick--;
-			firstRun = false;
-		}
-	}
-
-};
-
-bool TransientSolver::RampUp(std::map<Net *, double> originalVoltages, double tol, int maxIter) {
-	double currentTime = 0;
-	bool firstRun = true;
-	bool status = true;
-	for(int i = 0; i < 10; i++) {
-		currentTick++;
-		nextTimestep = 1e-3;
-		VariableValues.push_back(VariableValues[currentTick - 1]);
-		times.push_back(currentTime);
-
-		 
-		if (firstRun) {
-			try {
-				Tick(tol, maxIter);
-			}
-			catch (std::runtime_error *e) {
-				//Runtime errors are common on the first tick and can safely be ignored.
-			}
-		}
-		else {
-			int iter = Tick(tol, maxIter);
-			if (iter == maxIter) {
-				std::cerr << "Source ramp convergence failure at t=" << currentTime << std::endl;
-				status = false;
-			}
-				
-		}
-
-		currentTime += nextTimestep;
-
-		//Ramp up fixed voltage nets
-		for each(auto net in originalVoltages) {
-			Net *vNet = net.first;
-			if (abs(vNet->NetVoltage) < abs(net.second))
-				vNet->NetVoltage += net.second * 0.1;
-		}
-
-		if (firstRun) {
-			VariableValues.erase(VariableValues.end() - 1);
-			times.erase(times.end() - 1);
-			currentTick--;
-			firstRun = false;
-		}
-	}
-	return status;
-}
-
-void TransientSolver::Reset() {
-	VariableValues.clear();
-	nextTimestep = 0;
-	currentTick = 0;
-	VariableValues.push_back(std::vector<double>());
-	times.push_back(0);
-}
-
-void TransientSolver::RequestTimestep(double deltaT) {
-	if (deltaT < nextTimestep)
-		nextTimestep = deltaT;
-}
-
-void TransientSolver::SetNetVoltageGuess(Net *net, double value) {
-	VariableValues[currentTick][NetVariables[net]] = value;
+#include "TransientSolver.h"
+#include "AllocationCheck.h"
+#include <algorithm>
+#include <map>
+#include <limits>
+TransientSolver::TransientSolver()
+{
+	times.push_back(0);
+}
+
+TransientSolver::TransientSolver(DCSolver init)
+{
+	VariableNets = init.VariableNets;
+	VariableData = init.VariableData;
+	History = init.VariableValues;
+	FrameSize = init.VariableValues.size();
+	SolverCircuit = init.SolverCircuit;
+	for (auto net = SolverCircuit->Nets.begin(); net != SolverCircuit->Nets.end(); ++net) {
+		if ((*net)->IsFixedVoltage && ((*net)->Source != nullptr))
+			SourceNets.push_back(*net);
+	}
+	Residuals = init.Residuals;
+	ComponentStamps = init.ComponentStamps;
+	StampSlots = init.StampSlots;
+	Work.resize(1);
+	Work[0].Stamp.resize(init.MaxStampSize);
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		if (stamp->component->SupportsBypass()) {
+			int npin = stamp->numberOfPins;
+			BypassState state;
+			state.firstValue = BypassValues.size();
+			state.valid = false;
+			state.evaluations = 0;
+			state.bypasses = 0;
+			stamp->bypass = Bypass.size();
+			Bypass.push_back(state);
+			BypassValues.resize(BypassValues.size() + 2 * (2 * npin - 1) + (npin - 1) + (npin - 1) * (npin - 1) + (npin - 1) * npin);
+			if (Work[0].Bypass.size() < 2 * (2 * npin - 1))
+				Work[0].Bypass.resize(2 * (2 * npin - 1));
+		}
+	}
+	BuildBlocks(init.Jacobian, init.NetSlots, init.NetJacobianValues);
+	times.push_back(0);
+	SetOptions(SolverCircuit->Options);
+}
+
+TransientSolver::~TransientSolver() {
+	delete Workers;
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		for (auto group = block->Groups.begin(); group != block->Groups.end(); ++group) {
+			delete *group;
+		}
+	}
+}
+
+void TransientSolver::BuildBlocks(const SparseMatrix &jacobian, const std::vector<int> &netSlots, const std::vector<double> &netJacobianValues) {
+	int n = FrameSize;
+	//Join the row and column of every Jacobian entry, giving the connected groups of variables
+	std::vector<int> parent(n);
+	for (int i = 0; i < n; i++) parent[i] = i;
+	auto root = [&parent](int i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	};
+	std::vector<int> slotColumn(jacobian.GetNonZeroCount());
+	for (int c = 0; c < n; c++) {
+		for (int p = jacobian.ColumnStart[c]; p < jacobian.ColumnStart[c + 1]; p++) {
+			parent[root(jacobian.RowIndex[p])] = root(c);
+			slotColumn[p] = c;
+		}
+	}
+
+	//Number the variables of each block in the order of the variables themselves
+	Blocks.clear();
+	std::vector<int> blockOf(n, -1), localIndex(n);
+	for (int i = 0; i < n; i++) {
+		int r = root(i);
+		if (blockOf[r] < 0) {
+			blockOf[r] = Blocks.size();
+			Blocks.push_back(SolverBlock());
+		}
+		blockOf[i] = blockOf[r];
+		localIndex[i] = Blocks[blockOf[i]].Variables.size();
+		Blocks[blockOf[i]].Variables.push_back(i);
+	}
+
+	//Split the Jacobian, then move every slot over to the Jacobian of its block
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		block->Jacobian.Begin(block->Variables.size());
+	}
+	for (int c = 0; c < n; c++) {
+		for (int p = jacobian.ColumnStart[c]; p < jacobian.ColumnStart[c + 1]; p++) {
+			Blocks[blockOf[c]].Jacobian.AddEntry(localIndex[jacobian.RowIndex[p]], localIndex[c]);
+		}
+	}
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		block->Jacobian.Finalise();
+		block->JacobianLU.OrderColumns(block->Jacobian);
+	}
+	std::vector<int> localSlot(jacobian.GetNonZeroCount());
+	for (int p = 0; p < jacobian.GetNonZeroCount(); p++) {
+		localSlot[p] = Blocks[blockOf[slotColumn[p]]].Jacobian.GetSlot(localIndex[jacobian.RowIndex[p]], localIndex[slotColumn[p]]);
+	}
+	for (auto slot = StampSlots.begin(); slot != StampSlots.end(); ++slot) {
+		if (*slot >= 0) *slot = localSlot[*slot];
+	}
+	for (int k = 0; k < netSlots.size(); k++) {
+		SolverBlock &block = Blocks[blockOf[slotColumn[netSlots[k]]]];
+		block.NetSlots.push_back(localSlot[netSlots[k]]);
+		block.NetJacobianValues.push_back(netJacobianValues[k]);
+	}
+	for (auto net = VariableNets.begin(); net != VariableNets.end(); ++net) {
+		Blocks[blockOf[(*net)->VariableIndex]].Nets.push_back(*net);
+	}
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		SolverBlock &block = Blocks[blockOf[stamp->firstVariable]];
+		block.ComponentStamps.push_back(*stamp);
+		switch (stamp->component->GetJacobianDependence()) {
+		case Component::JACOBIAN_CONSTANT:
+			block.ConstantStamps.push_back(*stamp);
+			break;
+		case Component::JACOBIAN_PER_TICK:
+			block.TickStamps.push_back(*stamp);
+			break;
+		default:
+			block.NonlinearStamps.push_back(*stamp);
+			block.LimitStamps.push_back(*stamp);
+			break;
+		}
+	}
+
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		int nonZeros = block->Jacobian.GetNonZeroCount();
+		block->ConstantValues.resize(nonZeros);
+		block->TickValues.resize(nonZeros);
+		block->Step.resize(block->Variables.size());
+		block->LastValues.resize(block->Variables.size());
+		block->Linear = !block->ComponentStamps.empty();
+		for (auto stamp = block->ComponentStamps.begin(); stamp != block->ComponentStamps.end(); ++stamp) {
+			if (!stamp->component->IsLinear())
+				block->Linear = false;
+		}
+		if (block->Linear)
+			block->FactorisedValues.resize(nonZeros);
+	}
+	NewtonStep.assign(FrameSize, 0);
+	PredictedValues.assign(FrameSize, 0);
+	PredictionFailed.assign(FrameSize, false);
+	std::cerr << "Transient solver: " << Blocks.size() << " independent blocks" << std::endl;
+}
+
+void TransientSolver::AddComponent(Component *c) {
+	//Due to Kirchoff's Laws, for a component with n pins we only need n-1 equations
+
+	c->FirstVariable = nextFreeVariable;
+	nextFreeVariable += c->GetNumberOfPins() - 1;
+
+	for (int i = 0; i < c->GetNumberOfPins() - 1; i++) {
+		History.push_back(0);
+		FrameSize++;
+		VariableData.push_back(c->getComponentVariableIdentifier(i));
+	}
+	c->PinVariables.clear();
+	for (int i = 0; i < c->GetNumberOfPins(); i++) {
+		c->PinVariables.push_back(c->PinConnections[i]->IsFixedVoltage ? -1 : c->PinConnections[i]->VariableIndex);
+	}
+}
+
+void TransientSolver::AddNet(Net *net) {
+	net->VariableIndex = nextFreeVariable;
+	VariableNets.push_back(net);
+	History.push_back(0);
+	FrameSize++;
+	VariableData.push_back(net->GetNetVariableIdentifier());
+	nextFreeVariable++;
+}
+
+double TransientSolver::GetNetVoltage(Net *net, int n) {
+	if (n == -1) n = currentTick;
+	if (net->IsFixedVoltage) {
+		//NetVoltage only holds the voltage of a source at the current tick
+		if ((net->Source != nullptr) && (n != currentTick))
+			return net->Source->GetVoltage(GetTimeAtTick(n));
+		return net->NetVoltage;
+	}
+	else {
+		return GetFrame(n)[net->VariableIndex];
+	}
+}
+
+double TransientSolver::GetVarValue(int id, int tick) {
+	if (tick == -1) tick = currentTick;
+	return GetFrame(tick)[id];
+	
+}
+
+double TransientSolver::GetPinCurrent(Component *c, int pin, int n) {
+	if (n == -1) n = currentTick;
+	const double *values = GetFrame(n);
+	int npin = c->GetNumberOfPins();
+	if (pin < npin - 1) {
+		return values[c->FirstVariable + pin];
+	}
+	else {
+		double sum = 0;
+		for (int i = 0; i < npin - 1; i++) {
+			sum += values[c->FirstVariable + i];
+		}
+		return -sum;
+	}
+}
+
+int TransientSolver::GetCurrentTick() {
+	return currentTick;
+}
+
+double TransientSolver::GetTimeAtTick(int n) {
+	return times[GetSlot(n)];
+}
+
+double TransientSolver::GetTimestep() {
+	return GetTimeAtTick(currentTick) - GetTimeAtTick(currentTick - 1);
+}
+
+int TransientSolver::GetSlot(int tick) {
+	//Only the last FrameCount ticks are stored, so this never needs to wrap round more than once
+	int slot = firstSlot + tick;
+	if (slot >= FrameCount) slot -= FrameCount;
+	return slot;
+}
+
+double *TransientSolver::GetFrame(int tick) {
+	return &(History[GetSlot(tick) * FrameSize]);
+}
+
+int TransientSolver::GetFrameLimit() {
+	int limit = HistoryLength;
+	if (limit < MinimumHistoryLength) limit = MinimumHistoryLength;
+	return limit;
+}
+
+void TransientSolver::NewTick(double time) {
+	int previous = GetSlot(currentTick);
+	currentTick++;
+	if (currentTick == FrameCount) {
+		if ((FrameCount < GetFrameLimit()) && (firstSlot == 0)) {
+			FrameCount++;
+			History.resize(FrameCount * FrameSize);
+			times.push_back(0);
+		}
+		else {
+			//All slots are in use, so drop the oldest tick and reuse its slot
+			firstSlot = GetSlot(1);
+			currentTick--;
+		}
+	}
+	int slot = GetSlot(currentTick);
+	std::copy(History.begin() + previous * FrameSize, History.begin() + (previous + 1) * FrameSize, History.begin() + slot * FrameSize);
+	times[slot] = time;
+	PredictTick();
+}
+
+/*
+The Lagrange polynomial through the values of each variable at the last few ticks is evaluated at the time of the new
+tick. Its weights only depend on the tick times, so they are found once for all variables.
+*/
+void TransientSolver::PredictTick() {
+	TickPredicted = false;
+	//The tick just after a restart may itself follow a sudden change, so it is not used for a prediction
+	int order = std::min(PredictorOrder, std::min(TicksSinceRestart - 1, currentTick - 1));
+	if ((!UsePredictor) || (order < 1)) return;
+
+	double t[MaximumIntegrationOrder + 1];
+	double w[MaximumIntegrationOrder + 1];
+	if (order > MaximumIntegrationOrder) order = MaximumIntegrationOrder;
+	double time = GetTimeAtTick(currentTick);
+	for (int j = 0; j <= order; j++) {
+		t[j] = GetTimeAtTick(currentTick - 1 - j);
+		if ((j > 0) && (t[j] >= t[j - 1])) return;
+	}
+	if (time <= t[0]) return;
+	for (int j = 0; j <= order; j++) {
+		w[j] = 1;
+		for (int m = 0; m <= order; m++) {
+			if (m != j) w[j] *= (time - t[m]) / (t[j] - t[m]);
+		}
+	}
+
+	double *values = GetFrame(currentTick);
+	for (int i = 0; i < FrameSize; i++) {
+		if (PredictionFailed[i]) continue;
+		double predicted = 0;
+		for (int j = 0; j <= order; j++) {
+			predicted += w[j] * GetFrame(currentTick - 1 - j)[i];
+		}
+		values[i] = predicted;
+	}
+	std::copy(values, values + FrameSize, PredictedValues.begin());
+	TickPredicted = true;
+	PredictedTicks++;
+}
+
+void TransientSolver::DiscardTick() {
+	//The slot is kept for the next tick to reuse
+	currentTick--;
+}
+
+void TransientSolver::ReserveTicks(int count) {
+	//New slots are only ever added after the last tick, which is only valid before the ring wraps round
+	if (firstSlot != 0) return;
+	if (count > GetFrameLimit()) count = GetFrameLimit();
+	if (count > FrameCount) {
+		FrameCount = count;
+		History.resize(FrameCount * FrameSize);
+		times.resize(FrameCount);
+	}
+}
+
+double TransientSolver::GetTruncationError() {
+	double worst = 0;
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		worst = fmax(worst, stamp->component->GetTruncationError(this));
+	}
+	return worst;
+}
+
+double TransientSolver::CheckEvents() {
+	Breakpoint = std::numeric_limits<double>::infinity();
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		stamp->component->CheckEvents(this);
+	}
+	return Breakpoint;
+}
+
+void TransientSolver::RequestBreakpoint(double time) {
+	if (time < Breakpoint) Breakpoint = time;
+}
+
+bool TransientSolver::TickStartsAtEvent() {
+	return EventAtTickStart;
+}
+
+double TransientSolver::GetNextSourceBreakpoint(double time) {
+	double next = std::numeric_limits<double>::infinity();
+	for (auto net = SourceNets.begin(); net != SourceNets.end(); ++net) {
+		next = fmin(next, (*net)->Source->GetNextBreakpoint(time));
+	}
+	return next;
+}
+
+void TransientSolver::UpdateSources() {
+	double time = GetTimeAtTick(currentTick);
+	for (auto net = SourceNets.begin(); net != SourceNets.end(); ++net) {
+		(*net)->NetVoltage = (*net)->Source->GetVoltage(time);
+		RequestTimestep((*net)->Source->GetMaximumTimestep());
+	}
+}
+
+void TransientSolver::RejectTick() {
+	CurrentBlock = nullptr;
+	for (auto stamp = ComponentStamps.begin(); stamp != ComponentStamps.end(); ++stamp) {
+		stamp->component->RejectTick();
+	}
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		ResetStepLimits(*block);
+	}
+	DiscardTick();
+	TicksSinceRestart = 0;
+}
+
+void TransientSolver::SetOptions(ParameterSet options) {
+	std::string method = options.getString("method", "");
+	if (method == "be") {
+		Integration = BACKWARD_EULER;
+	}
+	else if (method == "trap") {
+		Integration = TRAPEZOIDAL;
+	}
+	else if (method == "bdf2") {
+		Integration = BDF2;
+	}
+	else if (method == "gear") {
+		Integration = GEAR;
+	}
+	else if (method != "") {
+		std::cerr << "WARNING : Unknown integration method " << method << std::endl;
+	}
+	GearMaximumOrder = (int)options.getDouble("maxorder", GearMaximumOrder);
+	if (GearMaximumOrder < 1) GearMaximumOrder = 1;
+	if (GearMaximumOrder > MaximumIntegrationOrder) GearMaximumOrder = MaximumIntegrationOrder;
+	TruncationRelativeTolerance = options.getDouble("reltol", TruncationRelativeTolerance);
+	TruncationVoltageTolerance = options.getDouble("vntol", TruncationVoltageTolerance);
+}
+
+void TransientSolver::SetIntegrationCoefficients() {
+	int available = std::min(currentTick, MaximumIntegrationOrder + 2);
+	for (int k = 0; k <= available; k++) {
+		IntegrationTimes[k] = GetTimeAtTick(currentTick - k);
+	}
+	RingingReported = false;
+
+	//The first tick of a simulation is at the time of the operating point, where every state keeps its value
+	double h = (currentTick > 0) ? (IntegrationTimes[0] - IntegrationTimes[1]) : 0;
+	if (h <= 0) {
+		IntegrationOrder = 1;
+		IntegrationCoefficients[1] = 1;
+		DerivativeWeights[0] = 0;
+		DerivativeWeights[1] = 0;
+		SetErrorOrder(1);
+		return;
+	}
+
+	int order = 2;
+	if (Integration == BACKWARD_EULER) {
+		order = 1;
+	}
+	else if (Integration == GEAR) {
+		order = std::max(1, std::min(GearOrder, GearMaximumOrder));
+	}
+	order = std::min(order, std::min(TicksSinceRestart + 1, currentTick));
+
+	if ((Integration == TRAPEZOIDAL) && (DampingTicksLeft == 0) && (order == 2)) {
+		IntegrationOrder = 1;
+		IntegrationCoefficients[1] = 1;
+		DerivativeWeights[0] = h / 2;
+		DerivativeWeights[1] = h / 2;
+		SetErrorOrder(2, true);
+	}
+	else {
+		double a[MaximumIntegrationOrder + 1];
+		Math::bdfCoefficients(IntegrationTimes, order, a);
+		IntegrationOrder = order;
+		for (int k = 1; k <= order; k++) {
+			IntegrationCoefficients[k] = -a[k] / a[0];
+		}
+		DerivativeWeights[0] = 1 / a[0];
+		DerivativeWeights[1] = 0;
+		SetErrorOrder(order);
+	}
+}
+
+/*
+The local truncation error of each method is its error constant, times h^(p+1) and the (p+1)th derivative of the state,
+where p is the order of the method. The error constants of the backward differentiation formulas are indexed by order.
+*/
+void TransientSolver::SetErrorOrder(int order, bool trapezoidal) {
+	static const double bdfErrorConstants[MaximumIntegrationOrder + 1] = { 0, 1.0 / 2, 2.0 / 9, 3.0 / 22, 12.0 / 125 };
+	ErrorOrder = order;
+	ErrorConstant = trapezoidal ? (1.0 / 12) : bdfErrorConstants[order];
+}
+
+int TransientSolver::GetIntegrationOrder() {
+	return IntegrationOrder;
+}
+
+double TransientSolver::GetIntegrationCoefficient(int k) {
+	return IntegrationCoefficients[k];
+}
+
+double TransientSolver::GetDerivativeWeight(int k) {
+	return DerivativeWeights[k];
+}
+
+int TransientSolver::GetTruncationErrorPoints() {
+	return (currentTick >= ErrorOrder + 1) ? (ErrorOrder + 2) : 0;
+}
+
+double TransientSolver::EstimateTruncationError(const double *state) {
+	double h = IntegrationTimes[0] - IntegrationTimes[1];
+	if (h <= 0) return 0;
+	return ErrorConstant * pow(h, ErrorOrder + 1) * fabs(Math::derivativeEstimate(IntegrationTimes, state, ErrorOrder + 1));
+}
+
+void TransientSolver::ReportRinging() {
+	RingingReported = true;
+}
+
+//The error of a method of order p goes as h^(p+1), so the timestep that would bring the error to 0.9 of the tolerance follows
+static double TimestepFactor(double error, int order, double growth) {
+	if (error <= 0) return growth;
+	return fmin(growth, 0.9 * pow(error, -1.0 / (order + 1)));
+}
+
+double TransientSolver::AcceptTick(double error) {
+	TicksSinceRestart++;
+	if (TickPredicted) {
+		double *values = GetFrame(currentTick);
+		double *previous = GetFrame(currentTick - 1);
+		for (int i = 0; i < FrameSize; i++) {
+			PredictionFailed[i] = fabs(values[i] - PredictedValues[i]) > fabs(values[i] - previous[i]);
+		}
+	}
+	if (RingingReported && (Integration == TRAPEZOIDAL)) {
+		DampingTicksLeft = RingingDampingTicks;
+	}
+	else if (DampingTicksLeft > 0) {
+		DampingTicksLeft--;
+	}
+
+	double factor = TimestepFactor(error, ErrorOrder, TimestepGrowth);
+	if (Integration == GEAR) {
+		//Estimate the error the orders either side would have had, and use the one allowing the longest timestep next
+		int order = IntegrationOrder;
+		GearOrder = order;
+		if ((order < GearMaximumOrder) && (TicksSinceRestart > order) && (currentTick >= order + 2)) {
+			SetErrorOrder(order + 1);
+			double higher = TimestepFactor(GetTruncationError(), order + 1, TimestepGrowth);
+			if (higher > factor) {
+				factor = higher;
+				GearOrder = order + 1;
+			}
+		}
+		if (order > 1) {
+			SetErrorOrder(order - 1);
+			double lower = TimestepFactor(GetTruncationError(), order - 1, TimestepGrowth);
+			if (lower > factor) {
+				factor = lower;
+				GearOrder = order - 1;
+			}
+		}
+	}
+	return factor;
+}
+
+void TransientSolver::AssembleResiduals(SolverBlock &block) {
+	for (auto net = block.Nets.begin(); net != block.Nets.end(); ++net) {
+		Residuals[(*net)->VariableIndex] = -(*net)->TransientFunction(this);
+	}
+	if (block.Parallel)
+		EvaluateRuns(block.ComponentStamps, block.ResidualRuns, nullptr);
+	else
+		EvaluateResiduals(block.ComponentStamps.data(), 0, block.ComponentStamps.size(), Work[0]);
+	for (auto group = block.Groups.begin(); group != block.Groups.end(); ++group) {
+		(*group)->Evaluate(GetFrame(currentTick), &(Residuals[0]), nullptr);
+	}
+	ApplyTickStampsInvalidated(block);
+}
+
+void TransientSolver::EvaluateResiduals(const ComponentStamp *stamps, int begin, int end, EvaluationWork &work) {
+	double *f = &(work.Stamp[0]);
+	for (int k = begin; k < end; k++) {
+		const ComponentStamp &stamp = stamps[k];
+		EvaluateStamp(stamp, f, nullptr, nullptr, work);
+		for (int i = 0; i < (stamp.numberOfPins - 1); i++) {
+			Residuals[stamp.firstVariable + i] = -f[i];
+		}
+	}
+}
+
+void TransientSolver::AssembleJacobian(SolverBlock &block) {
+	ApplyTickStampsInvalidated(block);
+	if (!block.ConstantValuesValid) {
+		std::fill(block.ConstantValues.begin(), block.ConstantValues.end(), 0.0);
+		for (int k = 0; k < block.NetSlots.size(); k++) {
+			block.ConstantValues[block.NetSlots[k]] = block.NetJacobianValues[k];
+		}
+		for (auto stamp = block.ConstantStamps.begin(); stamp != block.ConstantStamps.end(); ++stamp) {
+			StampJacobian(*stamp, &(block.ConstantValues[0]), Work[0]);
+		}
+		block.ConstantValuesValid = true;
+		block.TickValuesValid = false;
+	}
+	if ((!block.TickValuesValid) || (DerivativeWeights[0] != block.TickValuesWeight)) {
+		block.TickValuesWeight = DerivativeWeights[0];
+		std::copy(block.ConstantValues.begin(), block.ConstantValues.end(), block.TickValues.begin());
+		for (auto stamp = block.TickStamps.begin(); stamp != block.TickStamps.end(); ++stamp) {
+			StampJacobian(*stamp, &(block.TickValues[0]), Work[0]);
+		}
+		block.TickValuesValid = true;
+		TickStampsInvalidated = false;
+	}
+
+	std::copy(block.TickValues.begin(), block.TickValues.end(), block.Jacobian.Values.begin());
+	double *values = &(block.Jacobian.Values[0]);
+	if (block.Parallel) {
+		EvaluateRuns(block.NonlinearStamps, block.JacobianRuns, values);
+	}
+	else {
+		for (auto stamp = block.NonlinearStamps.begin(); stamp != block.NonlinearStamps.end(); ++stamp) {
+			StampJacobian(*stamp, values, Work[0]);
+		}
+	}
+	for (auto group = block.Groups.begin(); group != block.Groups.end(); ++group) {
+		(*group)->Evaluate(GetFrame(currentTick), nullptr, values);
+	}
+	ApplyTickStampsInvalidated(block);
+}
+
+void TransientSolver::ApplyTickStampsInvalidated(SolverBlock &block) {
+	if (TickStampsInvalidated) {
+		block.TickValuesValid = false;
+		TickStampsInvalidated = false;
+	}
+}
+
+void TransientSolver::PrepareBlocks() {
+	BlocksPrepared = true;
+	//Components may still be limited from the last step of the DC solver
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		ResetStepLimits(*block);
+	}
+	if (GroupDevices) {
+		for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+			BuildDeviceGroups(*block);
+		}
+	}
+	StartWorkers();
+}
+
+void TransientSolver::BuildDeviceGroups(SolverBlock &block) {
+	std::map<std::string, int> typeCount;
+	for (auto stamp = block.NonlinearStamps.begin(); stamp != block.NonlinearStamps.end(); ++stamp) {
+		typeCount[stamp->component->GetComponentType()]++;
+	}
+	std::map<std::string, DeviceGroup *> groupOfType;
+	for (auto type = typeCount.begin(); type != typeCount.end(); ++type) {
+		if (type->second < MinimumGroupSize) continue;
+		DeviceGroup *group = DeviceGroup::Create(type->first);
+		if (group != nullptr) {
+			groupOfType[type->first] = group;
+			block.Groups.push_back(group);
+		}
+	}
+	if (block.Groups.empty()) return;
+
+	auto isGrouped = [&](const ComponentStamp &stamp) {
+		return groupOfType.find(stamp.component->GetComponentType()) != groupOfType.end();
+	};
+	for (auto stamp = block.NonlinearStamps.begin(); stamp != block.NonlinearStamps.end(); ++stamp) {
+		if (isGrouped(*stamp))
+			groupOfType[stamp->component->GetComponentType()]->Add(*stamp, &(StampSlots[stamp->firstSlot]));
+	}
+	block.ComponentStamps.erase(std::remove_if(block.ComponentStamps.begin(), block.ComponentStamps.end(), isGrouped), block.ComponentStamps.end());
+	block.NonlinearStamps.erase(std::remove_if(block.NonlinearStamps.begin(), block.NonlinearStamps.end(), isGrouped), block.NonlinearStamps.end());
+	for (auto group = groupOfType.begin(); group != groupOfType.end(); ++group) {
+		group->second->UpdateParameters();
+		std::cerr << "Transient solver: evaluating " << group->second->GetSize() << " " << group->first << " devices as a group" << std::endl;
+	}
+}
+
+void TransientSolver::StartWorkers() {
+	int threads = WorkerThreads;
+	if (threads <= 0) threads = std::thread::hardware_concurrency();
+	if (threads <= 1) return;
+	bool anyParallel = false;
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		int residualCount, jacobianCount;
+		block->ResidualRuns = FindStampRuns(block->ComponentStamps, residualCount);
+		block->JacobianRuns = FindStampRuns(block->NonlinearStamps, jacobianCount);
+		block->Parallel = (residualCount >= ParallelThreshold);
+		if (block->Parallel) anyParallel = true;
+	}
+	if (!anyParallel) return;
+	Workers = new WorkerPool(threads);
+	Work.resize(threads, Work[0]);
+	std::cerr << "Transient solver: evaluating components on " << threads << " threads" << std::endl;
+}
+
+std::vector<TransientSolver::StampRun> TransientSolver::FindStampRuns(const std::vector<ComponentStamp> &stamps, int &parallelCount) {
+	std::vector<StampRun> runs;
+	parallelCount = 0;
+	int k = 0;
+	while (k < stamps.size()) {
+		StampRun run;
+		run.begin = k;
+		while ((k < stamps.size()) && stamps[k].component->SupportsParallelEvaluation()) k++;
+		run.parallel = ((k - run.begin) >= MinimumParallelRun);
+		if (run.parallel)
+			parallelCount += k - run.begin;
+		else if (k < stamps.size())
+			k++; //Include the component that stopped the run
+		run.end = k;
+		//Neighbouring runs on the simulation thread are merged
+		if (!run.parallel && !runs.empty() && !runs.back().parallel)
+			runs.back().end = run.end;
+		else
+			runs.push_back(run);
+	}
+	return runs;
+}
+
+void TransientSolver::EvaluateRuns(const std::vector<ComponentStamp> &stamps, const std::vector<StampRun> &runs, double *values) {
+	for (auto run = runs.begin(); run != runs.end(); ++run) {
+		if (run->parallel) {
+			JobStamps = &(stamps[run->begin]);
+			JobValues = values;
+			Workers->Run((values == nullptr) ? ResidualJob : JacobianJob, this, run->end - run->begin);
+		}
+		else if (values == nullptr) {
+			EvaluateResiduals(stamps.data(), run->begin, run->end, Work[0]);
+		}
+		else {
+			for (int k = run->begin; k < run->end; k++) {
+				StampJacobian(stamps[k], values, Work[0]);
+			}
+		}
+	}
+}
+
+void TransientSolver::ResidualJob(void *context, int thread, int begin, int end) {
+	TransientSolver *solver = (TransientSolver *)context;
+	solver->EvaluateResiduals(solver->JobStamps, begin, end, solver->Work[thread]);
+}
+
+void TransientSolver::JacobianJob(void *context, int thread, int begin, int end) {
+	TransientSolver *solver = (TransientSolver *)context;
+	for (int k = begin; k < end; k++) {
+		solver->StampJacobian(solver->JobStamps[k], solver->JobValues, solver->Work[thread]);
+	}
+}
+
+void TransientSolver::StepBlock(SolverBlock &block) {
+	double *values = GetFrame(currentTick);
+	int n = block.Variables.size();
+	for (int k = 0; k < n; k++) {
+		block.Step[k] = Residuals[block.Variables[k]];
+	}
+	block.JacobianLU.Solve(&(block.Step[0]));
+	if (LimitSteps && !block.Linear)
+		LimitStep(block, values);
+	for (int k = 0; k < n; k++) {
+		values[block.Variables[k]] += block.Step[k];
+	}
+}
+
+void TransientSolver::LimitStep(SolverBlock &block, const double *values) {
+	int n = block.Variables.size();
+	for (int k = 0; k < n; k++) {
+		NewtonStep[block.Variables[k]] = block.Step[k];
+	}
+	bool limited = false;
+	for (auto stamp = block.LimitStamps.begin(); stamp != block.LimitStamps.end(); ++stamp) {
+		bool wasLimited = stamp->component->IsStepLimited();
+		if (stamp->component->LimitStep(values, &(NewtonStep[0])))
+			limited = true;
+		//The last evaluation is no use for bypass if it was made at limited voltages, or the next one will be
+		if ((wasLimited || stamp->component->IsStepLimited()) && (stamp->bypass >= 0))
+			Bypass[stamp->bypass].valid = false;
+	}
+	block.StepLimited = limited;
+	if (limited) LimitedSteps++;
+}
+
+void TransientSolver::ResetStepLimits(SolverBlock &block) {
+	for (auto stamp = block.LimitStamps.begin(); stamp != block.LimitStamps.end(); ++stamp) {
+		if (!stamp->component->IsStepLimited()) continue;
+		stamp->component->ResetStepLimit();
+		if (stamp->bypass >= 0)
+			Bypass[stamp->bypass].valid = false;
+	}
+	block.StepLimited = false;
+}
+
+//Each component owns the rows of its functions, so stamps never overlap
+void TransientSolver::StampJacobian(const ComponentStamp &stamp, double *values, EvaluationWork &work) {
+	int npin = stamp.numberOfPins;
+	double *f = &(work.Stamp[0]);
+	double *dfdI = f + (npin - 1);
+	double *dfdV = dfdI + (npin - 1) * (npin - 1);
+	std::fill(dfdI, dfdV + (npin - 1) * npin, 0.0);
+	EvaluateStamp(stamp, f, dfdI, dfdV, work);
+
+	const int *slot = &(StampSlots[stamp.firstSlot]);
+	for (int i = 0; i < (npin - 1); i++) {
+		for (int pin = 0; pin < (npin - 1); pin++) {
+			values[*(slot++)] += dfdI[i * (npin - 1) + pin];
+		}
+		for (int pin = 0; pin < npin; pin++) {
+			if (*slot >= 0)
+				values[*slot] += dfdV[i * npin + pin];
+			slot++;
+		}
+	}
+}
+
+/*
+If no pin voltage or current of a component has moved outside the bypass tolerance since it was last evaluated, its
+functions are predicted from the values and derivatives found then. This is exact to first order, so it has
+the same effect on convergence as evaluating the component. Otherwise the component is evaluated with its
+derivatives, which become the new bypass state.
+*/
+void TransientSolver::EvaluateStamp(const ComponentStamp &stamp, double *f, double *dfdI, double *dfdV, EvaluationWork &work) {
+	if ((!DeviceBypass) || (stamp.bypass < 0)) {
+		stamp.component->TransientStamp(this, f, dfdI, dfdV);
+		return;
+	}
+	BypassState &state = Bypass[stamp.bypass];
+	int npin = stamp.numberOfPins;
+	double *lastX = &(BypassValues[state.firstValue]);
+	double *lastTol = lastX + (2 * npin - 1);
+	double *lastF = lastTol + (2 * npin - 1);
+	double *lastdfdI = lastF + (npin - 1);
+	double *lastdfdV = lastdfdI + (npin - 1) * (npin - 1);
+	const double *values = GetFrame(currentTick);
+	Component *c = stamp.component;
+
+	//Find the change in each pin current and voltage since the last evaluation
+	double *x = &(work.Bypass[0]);
+	double *dx = x + (2 * npin - 1);
+	for (int p = 0; p < (npin - 1); p++) {
+		x[p] = values[stamp.firstVariable + p];
+	}
+	for (int p = 0; p < npin; p++) {
+		int var = c->PinVariables[p];
+		x[(npin - 1) + p] = (var < 0) ? c->PinConnections[p]->NetVoltage : values[var];
+	}
+	bool bypass = state.valid;
+	for (int k = 0; k < (2 * npin - 1); k++) {
+		dx[k] = x[k] - lastX[k];
+		if (fabs(dx[k]) > lastTol[k])
+			bypass = false;
+	}
+
+	if (dfdI == nullptr) {
+		state.evaluations++;
+		if (bypass) state.bypasses++;
+	}
+	if (bypass) {
+		for (int i = 0; i < (npin - 1); i++) {
+			double value = lastF[i];
+			for (int p = 0; p < (npin - 1); p++) {
+				value += lastdfdI[i * (npin - 1) + p] * dx[p];
+			}
+			for (int p = 0; p < npin; p++) {
+				value += lastdfdV[i * npin + p] * dx[(npin - 1) + p];
+			}
+			f[i] = value;
+		}
+	}
+	else {
+		std::copy(x, x + (2 * npin - 1), lastX);
+		for (int k = 0; k < (2 * npin - 1); k++) {
+			lastTol[k] = BypassRelativeTolerance * fabs(x[k]) + ((k < (npin - 1)) ? BypassCurrentTolerance : BypassVoltageTolerance);
+		}
+		std::fill(lastdfdI, lastdfdV + (npin - 1) * npin, 0.0);
+		c->TransientStamp(this, lastF, lastdfdI, lastdfdV);
+		state.valid = true;
+		std::copy(lastF, lastF + (npin - 1), f);
+	}
+	if (dfdI != nullptr) {
+		std::copy(lastdfdI, lastdfdV + (npin - 1) * npin, dfdI);
+	}
+}
+
+void TransientSolver::PrintBypassStatistics() {
+	long long evaluations = 0, bypasses = 0;
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		for (auto stamp = block->ComponentStamps.begin(); stamp != block->ComponentStamps.end(); ++stamp) {
+			if (stamp->bypass < 0) continue;
+			const BypassState &state = Bypass[stamp->bypass];
+			evaluations += state.evaluations;
+			bypasses += state.bypasses;
+		}
+	}
+	if (evaluations == 0) return;
+	std::cerr << "Device bypass: " << (100.0 * bypasses / evaluations) << "% of evaluations (";
+	bool first = true;
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		for (auto stamp = block->ComponentStamps.begin(); stamp != block->ComponentStamps.end(); ++stamp) {
+			if (stamp->bypass < 0) continue;
+			const BypassState &state = Bypass[stamp->bypass];
+			if (!first) std::cerr << ", ";
+			std::cerr << stamp->component->ComponentID << " ";
+			if (state.evaluations > 0)
+				std::cerr << (100.0 * state.bypasses / state.evaluations) << "%";
+			else
+				std::cerr << "-";
+			first = false;
+		}
+	}
+	std::cerr << ")" << std::endl;
+}
+
+void TransientSolver::PrintNewtonStatistics() {
+	if (NonlinearBlockTicks == 0) return;
+	std::cerr << "Newton-Raphson: " << (NewtonIterations / (double)NonlinearBlockTicks) << " iterations per tick, "
+		<< LimitedSteps << " of " << NewtonIterations << " steps limited, " << RejectedTicks << " ticks rejected, "
+		<< PredictedTicks << " ticks predicted, " << BreakpointTicks << " breakpoints" << std::endl;
+}
+
+/*
+The functions of a linear block are f(x) = Jx + c, so a single Newton-Raphson step from any starting point solves
+them exactly. The Jacobian of a linear block depends only on the timestep, so most ticks can reuse the last
+factorisation.
+*/
+bool TransientSolver::LinearTick(SolverBlock &block, double tol) {
+	AssembleResiduals(block);
+	double worstTol = 0;
+	for (auto var = block.Variables.begin(); var != block.Variables.end(); ++var) {
+		worstTol = fmax(worstTol, fabs(Residuals[*var]));
+	}
+	if (worstTol < tol) return false;
+
+	//As there are no nonlinear components, the Jacobian is only assembled again if the timestep has changed
+	bool changed = (!block.JacobianFactorised) || (!block.TickValuesValid) || (!block.ConstantValuesValid)
+		|| (DerivativeWeights[0] != block.TickValuesWeight);
+	AssembleJacobian(block);
+	if (changed) {
+		//Small differences, such as rounding errors in the timestep, do not need a new factorisation
+		for (int k = 0; k < block.Jacobian.GetNonZeroCount(); k++) {
+			if (fabs(block.Jacobian.Values[k] - block.FactorisedValues[k]) > 1e-12 * fabs(block.FactorisedValues[k]))
+				block.JacobianFactorised = false;
+		}
+	}
+	if (!block.JacobianFactorised) {
+		block.JacobianLU.Factorise(block.Jacobian);
+		std::copy(block.Jacobian.Values.begin(), block.Jacobian.Values.end(), block.FactorisedValues.begin());
+		block.JacobianFactorised = true;
+		JacobianFactorisations++;
+	}
+	else {
+		JacobianReuses++;
+	}
+	StepBlock(block);
+	return true;
+}
+
+//Each block is solved in turn, and the number of iterations of a tick is that of the slowest block
+int TransientSolver::Tick(double tol, int maxIter, bool * convergenceFailureFlag) {
+	if (!BlocksPrepared) PrepareBlocks();
+	SetIntegrationCoefficients();
+	UpdateSources();
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	UnconvergedResidual = 0;
+	int iterations = 0;
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		CurrentBlock = &(*block);
+		int blockIterations;
+		if (block->Linear)
+			blockIterations = LinearTick(*block, tol) ? 1 : 0;
+		else
+			blockIterations = TickBlock(*block, tol, maxIter, startTime, convergenceFailureFlag);
+		if (blockIterations > iterations) iterations = blockIterations;
+	}
+	CurrentBlock = nullptr;
+	return iterations;
+}
+
+//This function is very similar to the function used to solve for a DC operating point.
+//See report section 2.4.1
+int TransientSolver::TickBlock(SolverBlock &block, double tol, int maxIter, std::chrono::steady_clock::time_point startTime, bool *convergenceFailureFlag) {
+	double *values = GetFrame(currentTick);
+	int n = block.Variables.size();
+	double worstTol = 0;
+	double lastWorstTol = 0;
+	int i;
+	int worstVar = -1;
+	bool convergenceFailure = false;
+
+	bool lastStepReused = false;
+
+	for (i = 0; i < maxIter; i++) {
+		//See report section 2.4.1.3
+		AssembleResiduals(block);
+		worstTol = 0;
+	    worstVar = -1;
+		for (auto var = block.Variables.begin(); var != block.Variables.end(); ++var) {
+			if (fabs(Residuals[*var]) > worstTol) {
+				worstTol = fabs(Residuals[*var]);
+				worstVar = *var;
+			}
+		}
+		if ((worstTol < tol) && (!block.StepLimited)) break;
+		/*
+		In modified Newton mode the factorised Jacobian from an earlier iteration, or an earlier tick, is kept
+		as long as each iteration still reduces the error by JacobianRefreshRatio. Otherwise, the Jacobian is
+		evaluated and factorised again for a full Newton step. A step with an old Jacobian that failed to
+		reduce the error is undone first, so a poor Jacobian can never make things worse than full Newton.
+		*/
+		bool refreshJacobian = (!ModifiedNewton) || (!block.JacobianFactorised) || (lastStepReused && (worstTol > JacobianRefreshRatio * lastWorstTol));
+		if (refreshJacobian && lastStepReused && (worstTol > lastWorstTol)) {
+			for (int k = 0; k < n; k++) {
+				values[block.Variables[k]] = block.LastValues[k];
+			}
+			ResetStepLimits(block);
+			AssembleResiduals(block);
+			worstTol = lastWorstTol;
+		}
+		if (refreshJacobian) {
+			AssembleJacobian(block);
+			block.JacobianFactorised = false;
+			block.JacobianLU.Factorise(block.Jacobian);
+			StepBlock(block);
+			block.JacobianFactorised = true;
+			JacobianFactorisations++;
+			lastStepReused = false;
+		}
+		else {
+			for (int k = 0; k < n; k++) {
+				block.LastValues[k] = values[block.Variables[k]];
+			}
+			StepBlock(block);
+			JacobianReuses++;
+			lastStepReused = true;
+		}
+		lastWorstTol = worstTol;
+		if (LimitTickTime && (std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() > maxTickTime)) {
+			std::cerr << "Tick timeout t=" << GetTimeAtTick(GetCurrentTick()) << " e=" << worstTol << std::endl;
+		
+			convergenceFailure = true;
+			break;
+		}
+	}
+	NewtonIterations += i;
+	NonlinearBlockTicks++;
+	if (i == maxIter) {
+		std::cerr << "Interactive convergence failure t=" << GetTimeAtTick(GetCurrentTick()) << " e=" << worstTol << " var=" << worstVar << std::endl;
+		convergenceFailure = true;
+	}
+	//Any failure to converge is flagged, so that the tick can be rejected
+	if (convergenceFailure) {
+		UnconvergedResidual = fmax(UnconvergedResidual, worstTol);
+		if (convergenceFailureFlag != nullptr)
+			*convergenceFailureFlag = true;
+	}
+
+	return i;
+}
+
+
+void TransientSolver::RunInteractive(double simSpeed, double tol, int maxIter) {
+	Run(simSpeed, std::numeric_limits<double>::infinity(), 0, 0, tol, maxIter);
+}
+
+bool TransientSolver::RunBatch(double stopTime, double outputStep, double maximumTimestep, double tol, int maxIter) {
+	return Run(0, stopTime, outputStep, maximumTimestep, tol, maxIter);
+}
+
+bool TransientSolver::Run(double simSpeed, double stopTime, double outputStep, double batchTimestep, double tol, int maxIter) {
+	bool batch = !std::isinf(stopTime);
+	LimitTickTime = !batch;
+	double currentTime = 0;
+	//In order to see timestep recommendations and initialise stateful components, run a timestep at 0s - but discard it, as the steady state represents the initial conditions
+	bool firstRun = true;
+	bool running = true;
+	bool failed = false;
+	//In batch mode ticks land on each output time as they do on the corners of sources
+	int outputCount = 0;
+	double nextOutputTime = batch ? fmin(outputStep, stopTime) : std::numeric_limits<double>::infinity();
+	const int ticktimestoAvg = 1200;
+	//Ring of the most recent tick times, oldest first from ticktimesStart
+	double ticktimes[ticktimestoAvg];
+	int ticktimesStart = 0, ticktimesCount = 0;
+	std::chrono::steady_clock::time_point lastUpdateTime;
+	double lastTimestep = 0;
+	bool hasLinearBlock = false;
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		if (block->Linear) hasLinearBlock = true;
+	}
+	ReserveTicks(HistoryLength);
+	double landedTimestep = 0; //Timestep before the current tick was shortened to end at a source corner, if it was
+#ifdef ALLOCATION_CHECK
+	auto factorisedBlocks = [&]() {
+		int count = 0;
+		for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+			if (block->JacobianLU.PivotingFactorisations > 0) count++;
+		}
+		return count;
+	};
+#endif
+	while (running) {
+#ifdef ALLOCATION_CHECK
+		long long allocationsBeforeTick = AllocationCheck::GetAllocationCount();
+		int factorisedBlocksBeforeTick = factorisedBlocks();
+#endif
+		double maximumTimestep = batch ? batchTimestep : (firstRun ? (simSpeed / 10) : (simSpeed * averageTickTime));
+		nextTimestep = maximumTimestep;
+		NewTick(currentTime);
+
+		std::chrono::steady_clock::time_point startT = std::chrono::steady_clock::now();
+
+		bool convergenceFailure = false;
+		if (firstRun) {
+			try {
+				Tick(tol, maxIter);
+			}
+			catch (std::runtime_error *e) {
+
+			}
+		}
+		else {
+			/*
+			A tick that fails to converge, or whose truncation error is above tolerance, is taken again with a shorter
+			timestep until it succeeds or the timestep reaches MinimumTimestep. A tick during which a component requested
+			a breakpoint is taken again ending at the breakpoint. The timesteps components requested during a rejected
+			tick are discarded along with it.
+			*/
+			double uncutTimestep = landedTimestep; //Timestep before the tick was cut to end at a breakpoint or corner, if it was
+			int rejections = 0;
+			//GetTimestep may round a retake at MinimumTimestep to slightly more, so a retake there is flagged instead
+			bool atMinimumTimestep = false;
+			while (true) {
+				double timestep = GetTimestep();
+				double lastTime = GetTimeAtTick(currentTick - 1);
+				bool canReject = RejectTicks && (!atMinimumTimestep) && (rejections < MaximumRejections) && (timestep > MinimumTimestep);
+				double error = 0;
+				double breakpoint = std::numeric_limits<double>::infinity();
+				convergenceFailure = false;
+				try {
+					Tick(tol, maxIter, &convergenceFailure);
+					error = GetTruncationError();
+					if (!convergenceFailure)
+						breakpoint = CheckEvents();
+				}
+				catch (std::runtime_error *e) {
+					if (!canReject) {
+						std::cerr << "RUNTIME ERROR AT T=" << currentTime << " : " << e->what() << std::endl;
+						SolverCircuit->ReportError("EXCEPTION", true);
+						running = false;
+						failed = true;
+						break;
+					}
+					delete e;
+					convergenceFailure = true;
+				}
+				if (canReject && (convergenceFailure || (error > 1))) {
+					//Most ticks are rejected at a sudden change, such as a logic output switching, where the error is proportional to the timestep
+					double shorter = convergenceFailure ? (timestep / 8) : (timestep * fmax(0.1, 0.9 / error));
+					RejectTick();
+					RejectedTicks++;
+					rejections++;
+					double retake = fmin(shorter, breakpoint - lastTime);
+					atMinimumTimestep = (retake <= MinimumTimestep);
+					currentTime = lastTime + fmax(retake, MinimumTimestep);
+					uncutTimestep = 0;
+					landedTimestep = 0;
+					nextTimestep = maximumTimestep;
+					NewTick(currentTime);
+					continue;
+				}
+				if (canReject && (breakpoint < currentTime - fmax(EventTolerance, MinimumTimestep))) {
+					RejectTick();
+					BreakpointTicks++;
+					rejections++;
+					uncutTimestep = fmax(uncutTimestep, timestep);
+					atMinimumTimestep = (breakpoint <= lastTime + MinimumTimestep);
+					currentTime = fmax(breakpoint, lastTime + MinimumTimestep);
+					nextTimestep = maximumTimestep;
+					NewTick(currentTime);
+					continue;
+				}
+				//A tick cut short by a breakpoint says little about the timestep needed, so the timestep it was cut from is kept
+				RequestTimestep(fmax(timestep * AcceptTick(error), uncutTimestep));
+				//The components change state at the start of the next tick, so the integration method restarts there
+				EventAtTickStart = (breakpoint <= currentTime);
+				//A source is not smooth at its corners either
+				if (EventAtTickStart || (GetNextSourceBreakpoint(lastTime) <= currentTime))
+					TicksSinceRestart = 0;
+				break;
+			}
+		}
+		
+
+		//A tick that failed with an exception has stopped the simulation, and is neither counted nor output
+		if ((!firstRun) && running) {
+			AcceptedTicks++;
+			if (batch) {
+				if (currentTime >= nextOutputTime) {
+					if (InteractiveCallback != nullptr) {
+						(*InteractiveCallback)(this);
+					}
+					if (nextOutputTime >= stopTime)
+						running = false;
+					outputCount++;
+					nextOutputTime = fmin((outputCount + 1) * outputStep, stopTime);
+				}
+			}
+			else if (std::chrono::duration<double>(std::chrono::steady_clock::now() - lastUpdateTime).count() > 2e-3) {
+				if (InteractiveCallback != nullptr) {
+					(*InteractiveCallback)(this);
+				}
+				lastUpdateTime = std::chrono::steady_clock::now();
+			}
+		}
+
+		//In interactive mode each tick takes at least 100us, and the timestep is set from how long recent ticks took
+		if (!batch) {
+			double timeForTick = std::chrono::duration<double>(std::chrono::steady_clock::now() - startT).count();
+			while (timeForTick < 1e-4)
+				timeForTick = std::chrono::duration<double>(std::chrono::steady_clock::now() - startT).count();
+
+			//Recalculate tick time 
+			if (ticktimesCount < ticktimestoAvg) {
+				ticktimes[ticktimesCount++] = timeForTick;
+			}
+			else {
+				ticktimes[ticktimesStart] = timeForTick;
+				ticktimesStart = (ticktimesStart + 1) % ticktimestoAvg;
+			}
+			double ttsum = 0;
+			for (int k = 0; k < ticktimesCount; k++)
+				ttsum += ticktimes[(ticktimesStart + k) % ticktimestoAvg];
+			averageTickTime = ttsum / ticktimesCount;
+
+			totalNumberOfTicks++;
+			if ((totalNumberOfTicks % 30) == 0) {
+				std::cerr << averageTickTime << std::endl;
+			}
+			if (((totalNumberOfTicks % 3000) == 0) && (currentTime > 0)) {
+				std::cerr << "Jacobian factorisations: " << JacobianFactorisations << ", reused: " << JacobianReuses
+					<< " (" << (JacobianReuses / currentTime) << " saved per simulated second)" << std::endl;
+				PrintBypassStatistics();
+				PrintNewtonStatistics();
+			}
+		}
+		//Never exceed the timestep requested, but avoid factorising a linear block again for a slightly larger one
+		if (hasLinearBlock && (!firstRun) && (nextTimestep >= lastTimestep) && (nextTimestep <= (1 + TimestepHysteresis) * lastTimestep))
+			nextTimestep = lastTimestep;
+		lastTimestep = nextTimestep;
+		currentTime += nextTimestep;
+		/*
+		End the next tick at the next corner of a source, or output time, if it would pass it or nearly reach it, and split
+		the time to it if it would otherwise leave a much shorter tick
+		*/
+		double tickStart = GetTimeAtTick(currentTick);
+		double landingTime = fmin(GetNextSourceBreakpoint(tickStart), nextOutputTime);
+		landedTimestep = 0;
+		if (currentTime >= landingTime - 1e-3 * nextTimestep) {
+			if (currentTime > landingTime)
+				landedTimestep = nextTimestep;
+			currentTime = landingTime;
+		}
+		else if ((landingTime - currentTime) < 0.5 * nextTimestep) {
+			currentTime = (tickStart + landingTime) / 2;
+		}
+		//A tick that could not be rejected is kept even if it did not converge, but only reported where e>1
+		if (convergenceFailure && (UnconvergedResidual > 1))
+			SolverCircuit->ReportError("CONVERGENCE", false);
+#ifdef ALLOCATION_CHECK
+		long long tickAllocations = AllocationCheck::GetAllocationCount() - allocationsBeforeTick;
+		//The first factorisation of a block finds the pattern of its factors, so cannot avoid allocating
+		if ((!firstRun) && (tickAllocations > 0) && (factorisedBlocks() == factorisedBlocksBeforeTick)) {
+			std::cerr << "WARNING: " << tickAllocations << " allocations during tick at t=" << GetTimeAtTick(currentTick) << std::endl;
+			if (batch)
+				failed = true;
+		}
+#endif
+
+		if (firstRun) {
+			DiscardTick();
+			firstRun = false;
+		}
+	}
+	return !failed;
+};
+
+void TransientSolver::Reset() {
+	History.assign(FrameSize, 0);
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		block->TickValuesValid = false;
+	}
+	times.assign(1, 0);
+	FrameCount = 1;
+	firstSlot = 0;
+	nextTimestep = 0;
+	currentTick = 0;
+	TicksSinceRestart = 0;
+	GearOrder = 1;
+	DampingTicksLeft = 0;
+	TickPredicted = false;
+	PredictionFailed.assign(FrameSize, false);
+	EventAtTickStart = false;
+}
+
+void TransientSolver::RequestTimestep(double deltaT) {
+	double current = nextTimestep;
+	while ((deltaT < current) && (!nextTimestep.compare_exchange_weak(current, deltaT)));
+}
+
+bool TransientSolver::IsLinearBlock() {
+	return (CurrentBlock != nullptr) && CurrentBlock->Linear;
+}
+
+int TransientSolver::GetNumberOfBlocks() {
+	return Blocks.size();
+}
+
+void TransientSolver::InvalidateTickStamps() {
+	if (CurrentBlock != nullptr) {
+		TickStampsInvalidated = true;
+	}
+	else {
+		for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+			block->TickValuesValid = false;
+		}
+	}
+}
+
+void TransientSolver::ParametersChanged() {
+	for (auto state = Bypass.begin(); state != Bypass.end(); ++state) {
+		state->valid = false;
+	}
+	for (auto block = Blocks.begin(); block != Blocks.end(); ++block) {
+		block->ConstantValuesValid = false;
+		block->TickValuesValid = false;
+		block->JacobianFactorised = false;
+		for (auto group = block->Groups.begin(); group != block->Groups.end(); ++group) {
+			(*group)->UpdateParameters();
+		}
+	}
+}
+
+void TransientSolver::SetNetVoltageGuess(Net *net, double value) {
+	GetFrame(currentTick)[net->VariableIndex] = value;
 }
\ No newline at end of file
@@ -1,98 +1,514 @@
-#pragma once
-class Net;
-struct netConnection;
-class Component;
-#include <string>
-#include <vector>
-#include <iostream>
-#include <ctime>
-#include <deque>
-#include <cstdlib> 
-#include <thread>
-
-#include "Math.h"
-
-#include "Component.h"
-#include "Net.h"
-#include "Circuit.h"
-
-#include "DCSolver.h"
-
-
-typedef void (*fnTickCallback) (TransientSolver *t);
-
-class TransientSolver
-{
-public:
-	TransientSolver();
-	TransientSolver(DCSolver init);
-
-	//Add components and nets to be included in the solver
-	void AddComponent(Component *c);
-	void AddNet(Net *net);
-
-	//Run a single Newton-Raphson solve 'tick'
-	int Tick(double tol = 1e-6, int maxIter = 50, bool *convergenceFailureFlag = nullptr);
-
-	//Run the solver in interactive mode
-	void RunInteractive(double simSpeed, double tol = 1e-6, int maxIter = 100);
-
-	/*
-	Performs a DC 'ramp-up' simulation. Initial operating point must have all fixed voltage nets at 0V
-	Returns whether or not successful
-	*/
-	bool RampUp(std::map<Net *, double> originalVoltages, double tol = 1e-12, int maxIter = 400);
-
-	//Get value of a net voltage at current point in solve routine, given the tick number (-1 for current time)
-	double GetNetVoltage(Net *net, int n = -1);
-
-	//Get value of current going INTO a pin at current point in solve routine given the tick number
-	double GetPinCurrent(Component *c, int pin, int n = -1);
-
-	//Get current tick number
-	int GetCurrentTick();
-
-	//Get time that a given tick occurred
-	double GetTimeAtTick(int n);
-
-	//To be called by components, to recommend the next timestep
-	void RequestTimestep(double deltaT);
-
-	//Clears all results
-	void Reset();
-
-	//Get variable value given ID and tick
-	double GetVarValue(int id, int tick = -1);
-
-	//This function is called after an interactive simulation tick
-	fnTickCallback InteractiveCallback = nullptr;
-
-	//Sets the guess value for a net voltage
-	void SetNetVoltageGuess(Net *net, double vale);
-
-private:
-	int nextFreeVariable = 0;
-	double nextTimestep = 0;
-	int currentTick = 0;
-	int totalNumberOfTicks = 0;
-	double averageTickTime = 0;
-
-	std::map<Net *, int> NetVariables; //Map pointers to nets to net voltage variable IDs
-
-	//Note that there are n-1 (where n=number of pins) variables allocated to each component
-	std::map<Component *, int> ComponentVariables; //Map component pins to pin current variable IDs
-
-	std::map<int, VariableIdentifier> VariableData; //Allow variables to be looked up
-
-	std::deque<std::vector<double>> VariableValues; //Map variable IDs to values at a given tick
-
-	std::deque<double> times; //Time at each tick
-
-	const int bufferSize = 10000; //During interactive simulations, number of components to store
-
-	//Max time for single tick
-	const double maxTickTime = 0.4;
-	
-	Circuit *SolverCircuit;
-};
-
+#pragma once
+class Net;
+struct netConnection;
+struct ComponentStamp;
+class Component;
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cstdlib> 
+#include <thread>
+#include <atomic>
+
+#include "Math.h"
+#include "SparseLU.h"
+
+#include "Component.h"
+#include "Net.h"
+#include "Circuit.h"
+
+#include "DCSolver.h"
+#include "WorkerPool.h"
+#include "DeviceGroup.h"
+
+
+typedef void (*fnTickCallback) (TransientSolver *t);
+
+class TransientSolver
+{
+public:
+	TransientSolver();
+	TransientSolver(DCSolver init);
+	~TransientSolver();
+
+	//Add components and nets to be included in the solver
+	void AddComponent(Component *c);
+	void AddNet(Net *net);
+
+	//Run a single Newton-Raphson solve 'tick'
+	int Tick(double tol = 1e-6, int maxIter = 50, bool *convergenceFailureFlag = nullptr);
+
+	//Run the solver in interactive mode
+	void RunInteractive(double simSpeed, double tol = 1e-6, int maxIter = 100);
+
+	/*
+	Run the solver in batch mode, from the operating point to stopTime as fast as possible rather than paced against
+	the wall clock. Ticks end exactly at every multiple of outputStep and at stopTime, and InteractiveCallback is called
+	after each of these. No tick is longer than maximumTimestep. Returns false if the simulation was stopped by an error,
+	or if built with ALLOCATION_CHECK and a tick allocated memory (see AllocationCheck.h).
+	*/
+	bool RunBatch(double stopTime, double outputStep, double maximumTimestep, double tol = 1e-6, int maxIter = 100);
+
+	//Get value of a net voltage at current point in solve routine, given the tick number (-1 for current time)
+	double GetNetVoltage(Net *net, int n = -1);
+
+	//Get value of current going INTO a pin at current point in solve routine given the tick number
+	double GetPinCurrent(Component *c, int pin, int n = -1);
+
+	//Get current tick number
+	int GetCurrentTick();
+
+	//Get time that a given tick occurred
+	double GetTimeAtTick(int n);
+
+	//Get the time between the previous tick and the current one. The DC solver gives an infinite timestep
+	double GetTimestep();
+
+	//To be called by components, to recommend the next timestep
+	void RequestTimestep(double deltaT);
+
+	/*
+	To be called by components from Component::CheckEvents, when an event such as a logic input crossing its threshold
+	happened at the given time during the tick just solved. The tick is taken again ending at the earliest breakpoint
+	requested, unless it is within EventTolerance of the end of the tick.
+	*/
+	void RequestBreakpoint(double time);
+
+	//Whether the current tick starts at an event, that is the last tick ended at a breakpoint
+	bool TickStartsAtEvent();
+
+	/*
+	Get the time of the first corner of any source waveform (see Net::Source) after a given time, or infinity if there
+	are none. Ticks end exactly at each corner, so the timestep can stay long between them.
+	*/
+	double GetNextSourceBreakpoint(double time);
+
+	//To be called by components with JACOBIAN_PER_TICK derivatives if they change other than through GetDerivativeWeight(0)
+	void InvalidateTickStamps();
+
+	//To be called when component parameters are changed during a simulation, so that no cached derivatives are used
+	void ParametersChanged();
+
+	//Clears all results
+	void Reset();
+
+	//Get variable value given ID and tick
+	double GetVarValue(int id, int tick = -1);
+
+	//This function is called after an interactive simulation tick, or at each output time in batch mode
+	fnTickCallback InteractiveCallback = nullptr;
+
+	/*
+	Integration method used by components whose functions integrate over the timestep, such as capacitors. A state x
+	at the current tick n is found from its values at the last few ticks and its derivative, as
+		x(n) = c[1]*x(n-1) + ... + c[order]*x(n-order) + w[0]*dx/dt(n) + w[1]*dx/dt(n-1)
+	where the coefficients depend on the timesteps of those ticks.
+
+	Backward Euler is first order. The trapezoidal rule is second order, but rings after a sudden change, so once a
+	component reports ringing (see ReportRinging) BDF2 is used instead for the next RingingDampingTicks ticks. BDF2 is
+	the second order backward differentiation formula, and GEAR uses the backward differentiation formulas of order 1
+	to GearMaximumOrder, choosing the order at each tick that allows the longest next timestep. Every method starts
+	at first order after the operating point and after a rejected tick, so that it only uses ticks since then.
+	*/
+	enum IntegrationMethod {
+		BACKWARD_EULER,
+		TRAPEZOIDAL,
+		BDF2,
+		GEAR
+	};
+	IntegrationMethod Integration = TRAPEZOIDAL;
+	int GearMaximumOrder = 2;
+	int RingingDampingTicks = 10;
+	static const int MaximumIntegrationOrder = 4;
+
+	/*
+	Set the integration method and timestep control from the OPTIONS given in a netlist (see Circuit::Options):
+	method=be|trap|bdf2|gear, maxorder (for gear), reltol and vntol (see TruncationRelativeTolerance)
+	*/
+	void SetOptions(ParameterSet options);
+
+	//Get the number of previous ticks used by the integration method for the current tick, and its coefficients c[k] and w[k] as above
+	int GetIntegrationOrder();
+	double GetIntegrationCoefficient(int k);
+	double GetDerivativeWeight(int k);
+
+	//Get the number of ticks, counting back from the current one, whose state is passed to EstimateTruncationError, or 0 if there are not enough ticks yet
+	int GetTruncationErrorPoints();
+
+	//Estimate the local truncation error of the current tick, given the state of a component (such as a capacitor's voltage) at each of the last GetTruncationErrorPoints ticks, newest first
+	double EstimateTruncationError(const double *state);
+
+	//To be called from GetTruncationError by components whose state has rung over the last few ticks, see Integration
+	void ReportRinging();
+
+	/*
+	Number of most recent ticks whose values are kept, which must be set before a simulation is started. Components
+	only look back as far as the integration method needs, so this can be as small as MinimumHistoryLength.
+	*/
+	int HistoryLength = 10000;
+	static const int MinimumHistoryLength = MaximumIntegrationOrder + 3;
+
+	//Sets the guess value for a net voltage
+	void SetNetVoltageGuess(Net *net, double vale);
+
+	/*
+	Modified Newton mode: reuse the factorised Jacobian across iterations and ticks, only evaluating and
+	factorising it again when an iteration fails to reduce the error by at least JacobianRefreshRatio
+	*/
+	bool ModifiedNewton = true;
+	double JacobianRefreshRatio = 0.5;
+
+	//Number of Newton-Raphson iterations that factorised a new Jacobian, and that reused an old one
+	long long JacobianFactorisations = 0;
+	long long JacobianReuses = 0;
+
+	/*
+	Device bypass: a component that supports it is not evaluated again while every pin voltage and current is
+	within BypassRelativeTolerance of its value at the last evaluation, plus the absolute tolerance
+	*/
+	bool DeviceBypass = true;
+	double BypassRelativeTolerance = 1e-6;
+	double BypassVoltageTolerance = 1e-6;
+	double BypassCurrentTolerance = 1e-9;
+
+	//Print the fraction of evaluations bypassed for each component that supports bypass
+	void PrintBypassStatistics();
+
+	/*
+	Junction voltage limiting: each Newton-Raphson step of a nonlinear block is passed to its nonlinear components before
+	it is taken, so that they can limit the voltages they are evaluated at (see Component::LimitStep). A block is not
+	taken to have converged while any of its components are limited.
+	*/
+	bool LimitSteps = true;
+
+	/*
+	Number of Newton-Raphson iterations taken by nonlinear blocks, the number of ticks they were solved for, and the
+	number of steps where any component was limited
+	*/
+	long long NewtonIterations = 0;
+	long long NonlinearBlockTicks = 0;
+	long long LimitedSteps = 0;
+
+	//Print the average number of Newton-Raphson iterations per tick, the number of steps limited, ticks rejected, ticks predicted and breakpoints
+	void PrintNewtonStatistics();
+
+	/*
+	Whether every component in the block being solved is linear. If so, each tick of the block is solved with a single
+	forward and back substitution, and its Jacobian is only factorised again when the timestep or a parameter changes.
+	*/
+	bool IsLinearBlock();
+
+	//Get the number of independent blocks the circuit is solved in
+	int GetNumberOfBlocks();
+
+	/*
+	If any block is linear, the timestep is held while the timestep components request is no more than this fraction
+	above it, so that small changes in the tick time do not cause the Jacobian to be factorised again
+	*/
+	double TimestepHysteresis = 0.2;
+
+	/*
+	Timestep control: after each tick the components estimate its local truncation error (see
+	Component::GetTruncationError), and the next timestep is chosen to bring the error within tolerance, growing by at
+	most TimestepGrowth times per tick. If RejectTicks is set, a tick whose error is above tolerance, or which fails to
+	converge, is rejected and taken again with a shorter timestep, down to MinimumTimestep. A tick is taken again at
+	most MaximumRejections times, counting retakes to end at a breakpoint, and is accepted once it has been taken at
+	MinimumTimestep. The timestep never exceeds that set by the simulation speed, or requested by components.
+	*/
+	double TruncationRelativeTolerance = 1e-3;
+	double TruncationVoltageTolerance = 1e-3;
+	bool RejectTicks = true;
+	double MinimumTimestep = 1e-10;
+	int MaximumRejections = 20;
+	double TimestepGrowth = 2;
+
+	//Number of ticks accepted, and number rejected and taken again with a shorter timestep
+	long long AcceptedTicks = 0;
+	long long RejectedTicks = 0;
+
+	//Breakpoints at most this long before the end of a tick are taken to be at the end of it
+	double EventTolerance = 1e-9;
+
+	//Number of ticks taken again to end at a breakpoint
+	long long BreakpointTicks = 0;
+
+	/*
+	Predictor: the initial guess for each tick is extrapolated from the polynomial through the last PredictorOrder + 1
+	accepted ticks, at their actual times, rather than copied from the previous tick. A plain copy is used at the start
+	of a simulation and after a rejected tick, and for any variable whose prediction at the last tick turned out worse
+	than a copy would have been, as happens around a logic output switching.
+	*/
+	bool UsePredictor = true;
+	int PredictorOrder = 2;
+
+	//Number of ticks whose initial guess was extrapolated
+	long long PredictedTicks = 0;
+
+	/*
+	Number of threads used to evaluate components, including the thread running the simulation, or 0 for one per
+	hardware thread. This must be set before a simulation is started. Only blocks with at least ParallelThreshold
+	components that support parallel evaluation (see Component::SupportsParallelEvaluation) are split between the
+	threads, as handing out the work costs more than evaluating a small circuit.
+	*/
+	int WorkerThreads = 0;
+	int ParallelThreshold = 256;
+
+	/*
+	Whether nonlinear devices of a type that appears at least MinimumGroupSize times in a block are evaluated together
+	in a DeviceGroup, rather than one at a time. This must be set before a simulation is started.
+	*/
+	bool GroupDevices = true;
+	int MinimumGroupSize = 8;
+
+private:
+	int nextFreeVariable = 0;
+	std::atomic<double> nextTimestep{ 0.0 }; //Components may request a timestep from several threads at once
+	int currentTick = 0;
+	int totalNumberOfTicks = 0;
+	double averageTickTime = 0;
+
+	/*
+	Each net and component records the variables it has been given (see Net::VariableIndex and Component::FirstVariable),
+	so finding a variable is an array lookup.
+	Note that there are n-1 (where n=number of pins) variables allocated to each component
+	*/
+	std::vector<Net *> VariableNets; //Nets with a voltage variable
+
+	std::vector<VariableIdentifier> VariableData; //Allow variables to be looked up
+
+	/*
+	Variable values and time at each stored tick. The values of a tick are a frame of FrameSize variables, and all
+	the frames are stored one after another in History, forming a ring. Once HistoryLength frames are in use the
+	oldest tick is dropped and its frame reused, so steady state ticks copy values between frames but never allocate.
+	Use GetSlot to find the slot of a tick, and GetFrame to find its values.
+	*/
+	std::vector<double> History;
+	std::vector<double> times;
+	int FrameSize = 0; //Number of variables
+	int FrameCount = 1; //Number of frames allocated
+	int firstSlot = 0; //Slot holding tick 0
+
+	//Get the slot in History and times used by a given tick
+	int GetSlot(int tick);
+
+	//Get the variable values at a given tick
+	double *GetFrame(int tick);
+
+	//Get the largest number of frames that may be allocated
+	int GetFrameLimit();
+
+	//Start a new tick at the given time, with its variable values initialised to those of the previous tick, or extrapolated if UsePredictor is set
+	void NewTick(double time);
+
+	//Extrapolate the variable values of the current tick from the previous ticks, if the predictor can be used for it
+	void PredictTick();
+	std::vector<double> PredictedValues; //Initial guess of the current tick, to check the prediction against once the tick is accepted
+	std::vector<char> PredictionFailed; //Set for each variable whose last prediction was worse than a copy of the previous tick
+	bool TickPredicted = false;
+
+	//Discard the most recent tick
+	void DiscardTick();
+
+	//Allocate the slots for a given number of ticks in advance, up to HistoryLength
+	void ReserveTicks(int count);
+
+	//Get the largest truncation error of any component in the tick just solved, as a fraction of the tolerance
+	double GetTruncationError();
+
+	//Integration method of the current tick (see Integration), set at the start of each tick
+	int IntegrationOrder = 1;
+	double IntegrationCoefficients[MaximumIntegrationOrder + 1];
+	double DerivativeWeights[2];
+	double IntegrationTimes[MaximumIntegrationOrder + 3]; //Times of the current and previous ticks, newest first
+	int ErrorOrder = 1; //Order of the method whose truncation error EstimateTruncationError finds
+	double ErrorConstant = 0.5;
+	int TicksSinceRestart = 0; //Ticks accepted since the integration method last started at first order
+	int GearOrder = 1; //Order chosen for the next tick by GEAR
+	int DampingTicksLeft = 0; //Ticks left using BDF2 in place of the trapezoidal rule
+	bool RingingReported = false;
+	void SetIntegrationCoefficients();
+
+	//Set the order whose truncation error EstimateTruncationError finds, for a backward differentiation formula, or the trapezoidal rule if trapezoidal is set
+	void SetErrorOrder(int order, bool trapezoidal = false);
+
+	/*
+	Shared by RunInteractive and RunBatch, batch mode being selected by a finite stopTime. In interactive mode the
+	timestep is limited by simSpeed and the time recent ticks took, in batch mode by batchTimestep.
+	*/
+	bool Run(double simSpeed, double stopTime, double outputStep, double batchTimestep, double tol, int maxIter);
+
+	//Update the integration method once a tick with the given truncation error has been accepted, returning the factor to change the timestep by
+	double AcceptTick(double error);
+
+	//Fixed nets with a source waveform, whose voltage is set at the start of each tick
+	std::vector<Net *> SourceNets;
+	void UpdateSources();
+
+	//Earliest breakpoint requested during the tick just solved, or infinity
+	double Breakpoint = 0;
+	bool EventAtTickStart = false;
+
+	//Check each component for events during the tick just solved, returning the earliest breakpoint requested
+	double CheckEvents();
+
+	//Reject the tick just solved, returning the components to their state at the start of the tick
+	void RejectTick();
+
+	//Largest residual left in a block that failed to converge during the tick just solved, or 0 if they all converged
+	double UnconvergedResidual = 0;
+
+	//Max time for single tick. Not applied in batch mode, where the results must not depend on how fast the host is
+	const double maxTickTime = 0.4;
+	bool LimitTickTime = true;
+
+	std::vector<double> Residuals; //Value of -f(x) for each function
+
+	//Slots that components and nets are stamped into, see DCSolver. Once the blocks are built, StampSlots index the Jacobian of each component's block
+	std::vector<ComponentStamp> ComponentStamps;
+	std::vector<int> StampSlots;
+
+	//Space used while evaluating a component, one for each thread
+	struct EvaluationWork {
+		std::vector<double> Stamp; //Functions and derivatives of the component being stamped
+		std::vector<double> Bypass; //Pin currents and voltages of the component being evaluated, then their changes
+	};
+	std::vector<EvaluationWork> Work;
+
+	/*
+	Fixed voltage nets, such as the power rails, are not variables, so circuits on the breadboard that only share these
+	nets do not depend on each other. The variables are split into blocks that are connected through the Jacobian,
+	and each block is solved with its own Jacobian and Newton-Raphson loop, so a block that has converged is not
+	iterated again while another is still converging.
+	*/
+	struct StampRun {
+		int begin, end; //Range of stamps
+		bool parallel; //Whether the range is split between threads
+	};
+
+	struct SolverBlock {
+		std::vector<int> Variables; //Variable of each row and column of the block Jacobian, in increasing order
+		std::vector<Net *> Nets; //Nets with a voltage variable in the block
+
+		/*
+		The stamps of the block, split by what their derivatives depend on (see Component::GetJacobianDependence).
+		Derivatives that do not depend on the variables are kept between iterations: ConstantValues holds the Jacobian
+		with only the nets and constant components stamped, and TickValues adds the components that are constant during
+		a tick, found again when the timestep changes. The nonlinear components are then stamped on top of TickValues
+		at each iteration.
+		*/
+		std::vector<ComponentStamp> ComponentStamps, ConstantStamps, TickStamps, NonlinearStamps;
+		std::vector<ComponentStamp> LimitStamps; //NonlinearStamps, including the stamps later moved into groups
+		bool StepLimited = false; //Whether any component was limited at the last step
+		std::vector<int> NetSlots;
+		std::vector<double> NetJacobianValues;
+		std::vector<double> ConstantValues, TickValues;
+		bool ConstantValuesValid = false;
+		bool TickValuesValid = false;
+		double TickValuesWeight = 0; //Weight of the derivative in the integration method that TickValues were found for, which depends on the timestep
+
+		SparseMatrix Jacobian;
+		SparseLU JacobianLU;
+		bool JacobianFactorised = false; //Whether JacobianLU holds a factorisation that can be reused
+		std::vector<double> Step; //Residuals of the block gathered for a Newton-Raphson step, then the step found
+		std::vector<double> LastValues; //Values of the block variables before the last step that reused the Jacobian, so it can be undone
+
+		bool Linear = false; //Whether every component in the block is linear
+		std::vector<double> FactorisedValues; //For a linear block, the Jacobian values that JacobianLU is a factorisation of
+
+		/*
+		If the block is split between threads, ComponentStamps and NonlinearStamps are evaluated as runs in their usual
+		order, so the results do not depend on the number of threads. Long runs of components that support parallel
+		evaluation are split between the threads, the other components are evaluated by the thread running the simulation.
+		*/
+		bool Parallel = false;
+		std::vector<StampRun> ResidualRuns, JacobianRuns;
+
+		//Groups of devices evaluated together, after the stamps. Grouped devices are removed from the stamps above
+		std::vector<DeviceGroup *> Groups;
+	};
+	std::vector<SolverBlock> Blocks;
+	SolverBlock *CurrentBlock = nullptr; //Block being solved, if any
+	bool BlocksPrepared = false;
+
+	//Group devices and start worker threads as set up, called at the first tick
+	void PrepareBlocks();
+
+	//Move the nonlinear devices of a block that can be evaluated together into groups
+	void BuildDeviceGroups(SolverBlock &block);
+
+	//Split the Jacobian found by the DC solver into blocks, moving StampSlots over to the block Jacobians
+	void BuildBlocks(const SparseMatrix &jacobian, const std::vector<int> &netSlots, const std::vector<double> &netJacobianValues);
+
+	/*
+	Set by InvalidateTickStamps while the components of CurrentBlock are evaluated, which may be on several threads,
+	and applied to the block once they have all finished
+	*/
+	std::atomic<bool> TickStampsInvalidated{ false };
+	void ApplyTickStampsInvalidated(SolverBlock &block);
+
+	/*
+	Worker threads, started at the first tick if any block is large enough to be split between them. Each thread
+	evaluates a range of JobStamps, either into Residuals or stamping their derivatives into JobValues. Each component
+	owns the rows of its functions, so the threads never write to the same entry.
+	*/
+	WorkerPool *Workers = nullptr;
+	const ComponentStamp *JobStamps = nullptr;
+	double *JobValues = nullptr;
+	static const int MinimumParallelRun = 16; //Shorter runs are evaluated by the thread running the simulation
+	void StartWorkers();
+	std::vector<StampRun> FindStampRuns(const std::vector<ComponentStamp> &stamps, int &parallelCount);
+	static void ResidualJob(void *context, int thread, int begin, int end);
+	static void JacobianJob(void *context, int thread, int begin, int end);
+
+	//Evaluate a set of stamps, into Residuals if values is null, otherwise stamping their derivatives into values
+	void EvaluateRuns(const std::vector<ComponentStamp> &stamps, const std::vector<StampRun> &runs, double *values);
+
+	//Evaluate the functions of stamps begin to end-1 into Residuals
+	void EvaluateResiduals(const ComponentStamp *stamps, int begin, int end, EvaluationWork &work);
+
+	//Run the Newton-Raphson loop for a nonlinear block, returning the number of iterations
+	int TickBlock(SolverBlock &block, double tol, int maxIter, std::chrono::steady_clock::time_point startTime, bool *convergenceFailureFlag);
+
+	//Solve a tick of a linear block, returning whether a step was needed
+	bool LinearTick(SolverBlock &block, double tol);
+
+	//Take a Newton-Raphson step for a block using the factorisation in its JacobianLU, limited if LimitSteps is set
+	void StepBlock(SolverBlock &block);
+
+	//Pass the step found for a block to its components to limit, before it is taken from values
+	void LimitStep(SolverBlock &block, const double *values);
+	std::vector<double> NewtonStep; //Step found for each variable, set for the variables of a block by LimitStep
+
+	//Return every component of a block to being evaluated without limiting
+	void ResetStepLimits(SolverBlock &block);
+
+	//Add the derivatives of a component to a set of Jacobian values
+	void StampJacobian(const ComponentStamp &stamp, double *values, EvaluationWork &work);
+
+	/*
+	For each component that can be bypassed, the pin currents (pins 0 to n-2) and pin voltages (pins 0 to n-1) at
+	its last evaluation, then how far each of these may move before it must be evaluated again, followed by the
+	functions and derivatives found, laid out as in EvaluationWork::Stamp
+	*/
+	struct BypassState {
+		int firstValue; //Index into BypassValues
+		bool valid; //Whether the component has been evaluated since the state was last cleared
+		long long evaluations; //Number of times the functions were needed
+		long long bypasses; //Number of those times that the component was bypassed
+	};
+	std::vector<BypassState> Bypass;
+	std::vector<double> BypassValues;
+
+	//Call TransientStamp for a component, unless it can be bypassed. dfdI and dfdV (if not null) must be zeroed
+	void EvaluateStamp(const ComponentStamp &stamp, double *f, double *dfdI, double *dfdV, EvaluationWork &work);
+
+	//Evaluate -f(x) for each function of a block into Residuals
+	void AssembleResiduals(SolverBlock &block);
+
+	//Evaluate the Jacobian of a block at the current variable values, leaving Residuals unchanged
+	void AssembleJacobian(SolverBlock &block);
+	
+	Circuit *SolverCircuit;
+};
+
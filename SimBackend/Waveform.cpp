@@ -0,0 +1,123 @@
+#include "Waveform.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+
+static const double infinity = std::numeric_limits<double>::infinity();
+static const double pi = 3.14159265358979323846;
+
+//Get parameter i, or a default value if it was left out
+static double getParam(const std::vector<double> &params, int i, double defaultValue) {
+	return (i < (int)params.size()) ? params[i] : defaultValue;
+}
+
+Waveform::~Waveform() {
+
+}
+
+double Waveform::GetMaximumTimestep() {
+	return infinity;
+}
+
+PulseWaveform::PulseWaveform(const std::vector<double> &params) {
+	V1 = getParam(params, 0, 0);
+	V2 = getParam(params, 1, 0);
+	Delay = getParam(params, 2, 0);
+	Rise = getParam(params, 3, 0);
+	Fall = getParam(params, 4, 0);
+	Width = getParam(params, 5, infinity);
+	Period = getParam(params, 6, infinity);
+	if ((Period <= 0) || (Period < Rise + Width + Fall)) {
+		std::cerr << "WARNING : Pulse period shorter than its rise, width and fall" << std::endl;
+		Period = infinity;
+	}
+}
+
+/*
+Both the voltage and the breakpoints are found from the corners of the period containing a time, computed in the same
+way, so that a tick ending at a corner sees exactly the voltage before it despite rounding.
+*/
+double PulseWaveform::GetPeriodStart(double time) {
+	if (std::isinf(Period) || (time <= Delay)) return Delay;
+	double start = Delay + floor((time - Delay) / Period) * Period;
+	//A time at the start of a period belongs to the period before
+	if (start >= time) start = Delay + (floor((time - Delay) / Period) - 1) * Period;
+	return start;
+}
+
+double PulseWaveform::GetVoltage(double time) {
+	if (time <= Delay) return V1;
+	double start = GetPeriodStart(time);
+	if (time <= start) return V1;
+	if (time < start + Rise) return V1 + (V2 - V1) * (time - start) / Rise;
+	if (time <= start + Rise + Width) return V2;
+	if (time < start + Rise + Width + Fall) return V2 + (V1 - V2) * (time - (start + Rise + Width)) / Fall;
+	return V1;
+}
+
+double PulseWaveform::GetNextBreakpoint(double time) {
+	if (time < Delay) return Delay;
+	double start = GetPeriodStart(time);
+	//The period containing a time may end at it, in which case the corner is in the next period
+	for (int n = 0; n < 2; n++) {
+		const double corners[] = { start, start + Rise, start + Rise + Width, start + Rise + Width + Fall };
+		for (int i = 0; i < 4; i++) {
+			if (corners[i] > time) return corners[i];
+		}
+		if (std::isinf(Period)) break;
+		start = GetPeriodStart(start + 1.5 * Period);
+	}
+	return std::numeric_limits<double>::infinity();
+}
+
+SineWaveform::SineWaveform(const std::vector<double> &params) {
+	Offset = getParam(params, 0, 0);
+	Amplitude = getParam(params, 1, 0);
+	Frequency = getParam(params, 2, 0);
+	Delay = getParam(params, 3, 0);
+	Damping = getParam(params, 4, 0);
+}
+
+double SineWaveform::GetVoltage(double time) {
+	double t = time - Delay;
+	if (t <= 0) return Offset;
+	return Offset + Amplitude * sin(2 * pi * Frequency * t) * exp(-Damping * t);
+}
+
+double SineWaveform::GetNextBreakpoint(double time) {
+	return (time < Delay) ? Delay : infinity;
+}
+
+double SineWaveform::GetMaximumTimestep() {
+	return (Frequency > 0) ? (1 / (Frequency * TicksPerCycle)) : infinity;
+}
+
+PwlWaveform::PwlWaveform(const std::vector<double> &params) {
+	for (int i = 0; i + 1 < (int)params.size(); i += 2) {
+		if ((!Times.empty()) && (params[i] < Times.back())) {
+			std::cerr << "WARNING : PWL point at " << params[i] << " is before the one before it, ignored" << std::endl;
+			continue;
+		}
+		Times.push_back(params[i]);
+		Voltages.push_back(params[i + 1]);
+	}
+	if (Times.empty()) {
+		Times.push_back(0);
+		Voltages.push_back(0);
+	}
+}
+
+double PwlWaveform::GetVoltage(double time) {
+	//The first point at or after the time given
+	int i = std::lower_bound(Times.begin(), Times.end(), time) - Times.begin();
+	if (i == 0) return Voltages.front();
+	if (i == (int)Times.size()) return Voltages.back();
+	if (Times[i] == Times[i - 1]) return Voltages[i - 1];
+	return Voltages[i - 1] + (Voltages[i] - Voltages[i - 1]) * (time - Times[i - 1]) / (Times[i] - Times[i - 1]);
+}
+
+double PwlWaveform::GetNextBreakpoint(double time) {
+	auto next = std::upper_bound(Times.begin(), Times.end(), time);
+	return (next == Times.end()) ? infinity : *next;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+/*
+Time-varying voltages for fixed nets, given in the netlist after the net name in the same form as SPICE sources:
+
+	NET name PULSE v1 v2 [delay rise fall width period]
+	NET name SIN offset amplitude frequency [delay damping]
+	NET name PWL t1 v1 t2 v2 ...
+
+Parameters left out default to 0, except that the width and period of a pulse default to infinity (a single step).
+Each waveform gives its voltage at any time, and the times of its corners. The voltage is not smooth at a corner, so
+the transient solver ends a tick exactly at each one (see TransientSolver::GetNextSourceBreakpoint).
+
+At a corner the voltage is that of the segment before it, so a step with no rise time is seen from the tick after
+the one ending at the step.
+*/
+class Waveform
+{
+public:
+	virtual ~Waveform();
+
+	//Get the voltage at a given time
+	virtual double GetVoltage(double time) = 0;
+
+	//Get the time of the first corner after a given time, or infinity if there are no more
+	virtual double GetNextBreakpoint(double time) = 0;
+
+	//Get the longest timestep that follows the waveform closely, or infinity if there is no limit
+	virtual double GetMaximumTimestep();
+};
+
+class PulseWaveform :
+	public Waveform
+{
+public:
+	PulseWaveform(const std::vector<double> &params);
+	double GetVoltage(double time);
+	double GetNextBreakpoint(double time);
+
+private:
+	double V1 = 0, V2 = 0;
+	double Delay = 0, Rise = 0, Fall = 0, Width, Period;
+
+	//Get the start of the period containing a time
+	double GetPeriodStart(double time);
+};
+
+class SineWaveform :
+	public Waveform
+{
+public:
+	SineWaveform(const std::vector<double> &params);
+	double GetVoltage(double time);
+	double GetNextBreakpoint(double time);
+	double GetMaximumTimestep();
+
+	//Number of ticks per cycle, at least
+	static const int TicksPerCycle = 20;
+
+private:
+	double Offset = 0, Amplitude = 0, Frequency = 0, Delay = 0, Damping = 0;
+};
+
+class PwlWaveform :
+	public Waveform
+{
+public:
+	PwlWaveform(const std::vector<double> &params);
+	double GetVoltage(double time);
+	double GetNextBreakpoint(double time);
+
+private:
+	//Times and voltages of the points, in order of time
+	std::vector<double> Times, Voltages;
+};
@@ -0,0 +1,94 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threads) {
+	if (threads < 1) threads = 1;
+	Threads = threads;
+	for (int i = 1; i < threads; i++) {
+		Workers.push_back(std::thread(&WorkerPool::WorkerLoop, this, i));
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Stopping = true;
+	}
+	WorkAvailable.notify_all();
+	for (auto worker = Workers.begin(); worker != Workers.end(); ++worker) {
+		worker->join();
+	}
+}
+
+void WorkerPool::Run(fnWorkerJob job, void *context, int count) {
+	int threads = GetNumberOfThreads();
+	if (threads == 1) {
+		job(context, 0, 0, count);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Job = job;
+		Context = context;
+		Count = count;
+		Remaining = Workers.size();
+		Generation++;
+	}
+	WorkAvailable.notify_all();
+
+	std::runtime_error *error = nullptr;
+	try {
+		job(context, 0, 0, count / threads);
+	}
+	catch (std::runtime_error *e) {
+		error = e;
+	}
+
+	std::unique_lock<std::mutex> lock(Lock);
+	WorkDone.wait(lock, [this] { return Remaining == 0; });
+	if (Error != nullptr) {
+		if (error == nullptr)
+			error = Error;
+		else
+			delete Error;
+		Error = nullptr;
+	}
+	if (error != nullptr)
+		throw error;
+}
+
+int WorkerPool::GetNumberOfThreads() const {
+	return Threads;
+}
+
+void WorkerPool::WorkerLoop(int thread) {
+	int threads = GetNumberOfThreads();
+	long long lastGeneration = 0;
+	std::unique_lock<std::mutex> lock(Lock);
+	while (true) {
+		WorkAvailable.wait(lock, [this, lastGeneration] { return Stopping || (Generation != lastGeneration); });
+		if (Stopping) return;
+		lastGeneration = Generation;
+		fnWorkerJob job = Job;
+		void *context = Context;
+		int count = Count;
+		lock.unlock();
+
+		std::runtime_error *error = nullptr;
+		try {
+			job(context, thread, (count * thread) / threads, (count * (thread + 1)) / threads);
+		}
+		catch (std::runtime_error *e) {
+			error = e;
+		}
+
+		lock.lock();
+		if (error != nullptr) {
+			if (Error == nullptr)
+				Error = error;
+			else
+				delete error;
+		}
+		if (--Remaining == 0)
+			WorkDone.notify_one();
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+/*
+A fixed set of worker threads that split a range of independent items between them
+
+Run divides items 0 to count-1 into one contiguous range per thread, the calling thread taking the first range,
+and returns once every range is done. A job is a plain function and context pointer rather than a std::function,
+so that starting one never allocates.
+*/
+typedef void(*fnWorkerJob) (void *context, int thread, int begin, int end);
+
+class WorkerPool
+{
+public:
+	//Start a pool where Run uses a given number of threads, including the calling thread
+	WorkerPool(int threads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/*
+	Call job for items 0 to count-1, split between the threads. A runtime_error thrown by any range is thrown again
+	by Run once all the threads have finished
+	*/
+	void Run(fnWorkerJob job, void *context, int count);
+
+	//Get the number of threads used by Run, including the calling thread
+	int GetNumberOfThreads() const;
+
+private:
+	int Threads;
+	std::vector<std::thread> Workers;
+	std::mutex Lock;
+	std::condition_variable WorkAvailable, WorkDone;
+
+	//The job being run, protected by Lock
+	fnWorkerJob Job = nullptr;
+	void *Context = nullptr;
+	int Count = 0;
+	long long Generation = 0; //Incremented each time a job is started
+	int Remaining = 0; //Number of worker threads yet to finish the job
+	std::runtime_error *Error = nullptr; //First error thrown by a worker thread
+	bool Stopping = false;
+
+	void WorkerLoop(int thread);
+};